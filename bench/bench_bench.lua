@@ -0,0 +1,10 @@
+-- Benchmarks for the benchmark harness itself (src/bench.c), and the baseline
+-- overhead of calling a Lua function.
+local system = require("system")
+
+local function noop() end
+
+return {
+  { name = "noop", fn = noop },
+  { name = "bench", fn = function() system.bench(noop, { warmup = 0, time = 0.00001, samples = 1 }) end },
+}
@@ -0,0 +1,18 @@
+-- Benchmarks for the bitflags object (src/bitflags.c).
+local system = require("system")
+
+local a = system.bitflag(12)
+local b = system.bitflag(7)
+
+return {
+  { name = "bitflag", fn = function() system.bitflag(5) end },
+  { name = "value", fn = function() a:value() end },
+  { name = "add", fn = function() return a + b end },
+  { name = "sub", fn = function() return a - b end },
+  { name = "eq", fn = function() return a == b end },
+  { name = "index", fn = function() return a[2] end },
+  { name = "newindex", fn = function() a[0] = true end },
+  { name = "has_all_of", fn = function() a:has_all_of(b) end },
+  { name = "has_any_of", fn = function() a:has_any_of(b) end },
+  { name = "tostring", fn = function() tostring(a) end },
+}
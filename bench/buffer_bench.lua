@@ -0,0 +1,13 @@
+-- Benchmarks for the byte buffer (src/buffer.c).
+local system = require("system")
+
+local buf_16 = system.buffer(16)
+local buf_1m = system.buffer(1024 * 1024)
+
+return {
+  { name = "fillrandom_16", fn = function() buf_16:fillrandom() end },
+  { name = "fillrandom_1m", fn = function() buf_1m:fillrandom() end },
+  { name = "random_1m", fn = function() system.random(1024 * 1024) end },  -- for comparison
+  { name = "tostring_16", fn = function() buf_16:tostring() end },
+  { name = "byte", fn = function() buf_16:byte(1) end },
+}
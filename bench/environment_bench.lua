@@ -0,0 +1,41 @@
+-- Benchmarks for the environment functions (src/environment.c).
+local system = require("system")
+
+local env = {}
+local names = {}
+for i = 1, 80 do
+  names[i] = "LUASYSTEM_BENCH_" .. i
+end
+local many = {}
+local template = ("listen ${LUASYSTEM_BENCH_HOST:-localhost}:${LUASYSTEM_BENCH_PORT:-8080} in $HOME\n"):rep(50)
+
+return {
+  { name = "getenv", fn = function() system.getenv("PATH") end },
+  { name = "getenv_missing", fn = function() system.getenv("LUASYSTEM_BENCH_MISSING") end },
+  { name = "setenv", fn = function() system.setenv("LUASYSTEM_BENCH", "value") end },
+  { name = "getenvs", fn = system.getenvs },
+  { name = "expandenv", fn = function() system.expandenv(template) end },
+  { name = "expandenv_gsub", fn = function()
+      -- the Lua equivalent, for comparison
+      template:gsub("%$%{([%w_]+):%-([^}]*)%}", function(name, default)
+        return system.getenv(name) or default
+      end):gsub("%$([%w_]+)", system.getenv)
+    end },
+  { name = "getenvmany_80", fn = function() system.getenvmany(names, many) end },
+  { name = "getenv_80", fn = function()
+      -- the equivalent with getenv, for comparison
+      for i = 1, 80 do many[names[i]] = system.getenv(names[i]) end
+    end },
+  { name = "getenvs_cached", fn = function() system.getenvs(env) end },
+  { name = "getenvs_update", fn = function() system.getenvs(env, true) end },
+  { name = "getenvs_prefix", fn = function() system.getenvs("LUASYSTEM_") end },
+  { name = "envpairs", fn = function()
+      for _ in system.envpairs() do end  -- luacheck: ignore
+    end },
+  { name = "envpairs_prefix", fn = function()
+      for _ in system.envpairs("LUASYSTEM_") do end  -- luacheck: ignore
+    end },
+  teardown = function()
+    system.setenv("LUASYSTEM_BENCH", nil)
+  end,
+}
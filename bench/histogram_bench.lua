@@ -0,0 +1,22 @@
+-- Benchmarks for the histogram object (src/histogram.c).
+local system = require("system")
+
+local hist = system.histogram()
+local other = system.histogram()
+for i = 1, 1000 do
+  hist:record(i * 1000)
+  other:record(i * 1000)
+end
+
+return {
+  { name = "histogram", fn = function() system.histogram() end },
+  { name = "record", fn = function() hist:record(123456) end },
+  { name = "start_stop", fn = function() hist:start() hist:stop() end },
+  { name = "percentile", fn = function() hist:percentile(99) end },
+  { name = "count", fn = function() hist:count() end },
+  { name = "min", fn = function() hist:min() end },
+  { name = "max", fn = function() hist:max() end },
+  { name = "mean", fn = function() hist:mean() end },
+  { name = "merge", fn = function() hist:merge(other) end },
+  { name = "reset", fn = function() other:reset() end },
+}
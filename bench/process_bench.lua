@@ -0,0 +1,31 @@
+-- Benchmarks for process spawning (src/process.c).
+local system = require("system")
+
+local env = system.getenvs()
+local block = system.envblock(env)
+local is_windows = package.config:sub(1,1) == "\\"
+
+local benchmarks = {
+  { name = "envblock", fn = function() system.envblock(env) end },
+}
+
+if not is_windows then
+  local argv = { "true" }
+  local opts_block = { env = block }
+  local opts_table = { env = env }
+
+  benchmarks[#benchmarks+1] = { name = "spawn", fn = function()
+    system.waitpid(system.spawn(argv))
+  end }
+  benchmarks[#benchmarks+1] = { name = "spawn_envblock", fn = function()
+    system.waitpid(system.spawn(argv, opts_block))
+  end }
+  benchmarks[#benchmarks+1] = { name = "spawn_envtable", fn = function()
+    system.waitpid(system.spawn(argv, opts_table))
+  end }
+  benchmarks[#benchmarks+1] = { name = "os_execute", fn = function()
+    os.execute("true")  -- for comparison, goes through a shell
+  end }
+end
+
+return benchmarks
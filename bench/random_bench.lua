@@ -0,0 +1,36 @@
+-- Benchmarks for the random functions (src/random.c).
+local system = require("system")
+
+local ints = {}
+local random = math.random
+local unpack = table.unpack or unpack  -- luacheck: ignore
+
+return {
+  { name = "random_1", fn = function() system.random(1) end },
+  { name = "random_16", fn = function() system.random(16) end },
+  { name = "random_1k", fn = function() system.random(1024) end },
+  { name = "random_1m", fn = function() system.random(1024 * 1024) end },
+  { name = "random_16m", fn = function() system.random(16 * 1024 * 1024) end },
+  { name = "fastrandom_1", fn = function() system.fastrandom(1) end },
+  { name = "fastrandom_16", fn = function() system.fastrandom(16) end },
+  { name = "fastrandom_1k", fn = function() system.fastrandom(1024) end },
+  { name = "fastrandom_1m", fn = function() system.fastrandom(1024 * 1024) end },
+  { name = "fastrandom_16m", fn = function() system.fastrandom(16 * 1024 * 1024) end },
+  { name = "randomints_1k", fn = function() system.randomints(1000, 1, 100, ints) end },
+  { name = "math_random_1k", fn = function()
+      -- the Lua equivalent, for comparison
+      for i = 1, 1000 do ints[i] = random(1, 100) end
+    end },
+  { name = "randompacked_1k_i4", fn = function() system.randompacked(1000, "i4", 1, 100) end },
+  { name = "randompacked_1k_d", fn = function() system.randompacked(1000, "d") end },
+  { name = "uuid4", fn = function() system.uuid4() end },
+  { name = "uuid7", fn = function() system.uuid7() end },
+  { name = "uuid4_lua", fn = function()
+      -- the Lua equivalent, for comparison
+      local b = { system.random(16):byte(1, 16) }
+      b[7] = b[7] % 16 + 0x40
+      b[9] = b[9] % 64 + 0x80
+      return string.format("%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x", unpack(b))
+    end },
+  { name = "uuids_1k", fn = function() system.uuids(1000) end },
+}
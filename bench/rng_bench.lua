@@ -0,0 +1,18 @@
+-- Benchmarks for the random number generator (src/rng.c).
+local system = require("system")
+
+local rng = system.rng(1)
+local random = math.random
+
+return {
+  { name = "rng", fn = function() system.rng() end },
+  { name = "int", fn = function() rng:int(1, 100) end },
+  { name = "int_full", fn = function() rng:int() end },
+  { name = "float", fn = function() rng:float() end },
+  { name = "math_random", fn = function() random(1, 100) end },
+  { name = "bytes_16", fn = function() rng:bytes(16) end },
+  { name = "bytes_1m", fn = function() rng:bytes(1024 * 1024) end },
+  { name = "normal", fn = function() rng:normal() end },
+  { name = "exponential", fn = function() rng:exponential() end },
+  { name = "jump", fn = function() rng:jump() end },
+}
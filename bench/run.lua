@@ -0,0 +1,106 @@
+--- Benchmark runner.
+-- Runs the benchmark suites, and writes the results as JSON to stdout, so they can
+-- be compared across versions. Progress is reported on stderr.
+--
+-- Usage: `lua bench/run.lua [pattern] [time]`
+--
+-- - `pattern`: a Lua pattern, only benchmarks whose name ("suite.function") matches are run.
+-- - `time`: the approximate time in seconds to measure each benchmark (default 0.5).
+--
+-- Besides the timings (in ns per call), `alloc` is the Lua memory allocated per call, in bytes.
+
+local system = require("system")
+
+local suites = { "bitflags", "histogram", "bench", "time", "random", "rng", "buffer", "environment", "process", "term", "sharedenv" }
+local dir = ((arg and arg[0]) or ""):match("^(.-)[^/\\]*$")
+local pattern = arg and arg[1] or "."
+local time = tonumber(arg and arg[2]) or 0.5
+
+
+
+local function json_string(s)
+  return '"' .. s:gsub('[%c"\\]', function(c)
+    return string.format("\\u%04x", c:byte())
+  end) .. '"'
+end
+
+local function json_number(n)
+  if n ~= n or n == math.huge or n == -math.huge then
+    return "null"
+  end
+  if n == math.floor(n) and math.abs(n) < 2^53 then
+    return string.format("%d", n)
+  end
+  return string.format("%.3f", n)
+end
+
+local fields = { "mean", "stddev", "min", "p50", "p90", "p99", "max", "samples", "iterations", "total", "alloc" }
+
+local function json_result(name, result)
+  local out = { '    {"name": ' .. json_string(name) }
+  if result.skipped then
+    out[#out+1] = '"skipped": ' .. json_string(result.skipped)
+  else
+    for _, field in ipairs(fields) do
+      out[#out+1] = json_string(field) .. ": " .. json_number(result[field])
+    end
+  end
+  return table.concat(out, ", ") .. "}"
+end
+
+
+-- returns the Lua memory allocated per call in bytes, with the collector stopped
+-- (at most 100 calls, or until 64 MiB was allocated)
+local function allocated(fn)
+  collectgarbage("collect")
+  collectgarbage("stop")
+  local start = collectgarbage("count")
+  local calls = 0
+  repeat
+    fn()
+    calls = calls + 1
+  until calls >= 100 or collectgarbage("count") - start > 64 * 1024
+  local kb = collectgarbage("count") - start
+  collectgarbage("restart")
+  collectgarbage("collect")
+  return math.floor(kb * 1024 / calls + 0.5)
+end
+
+
+
+local results = {}
+for _, suite_name in ipairs(suites) do
+  local suite = dofile(dir .. suite_name .. "_bench.lua")
+  local selected = {}
+  for _, bench in ipairs(suite) do
+    if (suite_name .. "." .. bench.name):match(pattern) then
+      selected[#selected+1] = bench
+    end
+  end
+
+  if #selected > 0 then
+    if suite.setup then suite.setup() end
+    for _, bench in ipairs(selected) do
+      local name = suite_name .. "." .. bench.name
+      io.stderr:write(name, "\n")
+      local result
+      if bench.skip then
+        result = { skipped = bench.skip }
+      else
+        result = system.bench(bench.fn, { time = time })
+        result.alloc = allocated(bench.fn)
+      end
+      results[#results+1] = json_result(name, result)
+    end
+    if suite.teardown then suite.teardown() end
+  end
+end
+
+io.write('{\n')
+io.write('  "version": ', json_string(system._VERSION), ',\n')
+local jit = rawget(_G, "jit")
+io.write('  "lua": ', json_string(jit and jit.version or _VERSION), ',\n')
+io.write('  "windows": ', tostring(system.windows), ',\n')
+io.write('  "unit": "ns",\n')
+io.write('  "results": [\n', table.concat(results, ",\n"), '\n  ]\n')
+io.write('}\n')
@@ -0,0 +1,22 @@
+-- Benchmarks for the environment functions with `sharedenv` enabled (src/environment.c),
+-- to compare with the "environment" suite. This suite must run last, since the
+-- shared environment cannot be disabled again.
+local system = require("system")
+
+local env = {}
+local names = {}
+for i = 1, 80 do
+  names[i] = "LUASYSTEM_BENCH_" .. i
+end
+local many = {}
+
+return {
+  setup = function() system.sharedenv(true) end,
+
+  { name = "getenv", fn = function() system.getenv("PATH") end },
+  { name = "getenv_missing", fn = function() system.getenv("LUASYSTEM_BENCH_MISSING") end },
+  { name = "setenv", fn = function() system.setenv("LUASYSTEM_BENCH", "value") end },
+  { name = "getenvs", fn = system.getenvs },
+  { name = "getenvmany_80", fn = function() system.getenvmany(names, many) end },
+  { name = "getenvs_update", fn = function() system.getenvs(env, true) end },
+}
@@ -0,0 +1,45 @@
+-- Benchmarks for the terminal functions (src/term.c).
+local system = require("system")
+
+local backup
+local stdin_tty = system.isatty(io.stdin)
+local termios = system.tcgetattr(io.stdin)
+local consoleflags = system.getconsoleflags(io.stdout)
+local nonblock = system.getnonblock(io.stdout)
+local cp = system.getconsolecp()
+local outputcp = system.getconsoleoutputcp()
+
+local not_a_tty = (not stdin_tty) and "stdin is not a tty" or nil
+
+return {
+  { name = "isatty", fn = function() system.isatty(io.stdin) end },
+  { name = "getconsoleflags", fn = function() system.getconsoleflags(io.stdout) end },
+  { name = "setconsoleflags", fn = function() system.setconsoleflags(io.stdout, consoleflags) end },
+  { name = "tcgetattr", fn = function() system.tcgetattr(io.stdin) end },
+  { name = "tcsetattr", skip = not_a_tty, fn = function() system.tcsetattr(io.stdin, system.TCSANOW, termios) end },
+  -- reopens stdout/stderr, which would interfere with writing the results
+  { name = "detachfds", skip = "modifies stdout and stderr", fn = system.detachfds },
+  { name = "getnonblock", fn = function() system.getnonblock(io.stdout) end },
+  { name = "setnonblock", fn = function() system.setnonblock(io.stdout, nonblock) end },
+  { name = "_readkey", fn = system._readkey },
+  { name = "readbytes", fn = system.readbytes },
+  -- parsing, with the input put back into the C input buffer
+  { name = "readansi_char", fn = function() system._unreadbytes("a") system.readansi(0) end },
+  { name = "readansi_utf8", fn = function() system._unreadbytes("界") system.readansi(0) end },
+  { name = "readansi_csi", fn = function() system._unreadbytes("\27[1;5A") system.readansi(0) end },
+  { name = "termsize", fn = system.termsize },
+  { name = "utf8cwidth", fn = function() system.utf8cwidth("界") end },
+  { name = "utf8swidth", fn = function() system.utf8swidth("Hello, 世界! Ünïcödé") end },
+  { name = "getconsolecp", fn = system.getconsolecp },
+  { name = "setconsolecp", fn = function() system.setconsolecp(cp) end },
+  { name = "getconsoleoutputcp", fn = system.getconsoleoutputcp },
+  { name = "setconsoleoutputcp", fn = function() system.setconsoleoutputcp(outputcp) end },
+  setup = function()
+    -- _readkey would block otherwise
+    backup = system.termbackup()
+    system.setnonblock(io.stdin, true)
+  end,
+  teardown = function()
+    system.termrestore(backup)
+  end,
+}
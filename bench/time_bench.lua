@@ -0,0 +1,36 @@
+-- Benchmarks for the time functions (src/time.c).
+local system = require("system")
+
+local timer = assert(system.timer(0.000001))
+local usage = {}
+
+return {
+  { name = "gettime", fn = system.gettime },
+  { name = "monotime", fn = system.monotime },
+  { name = "gettime_ns", fn = system.gettime_ns },
+  { name = "monotime_ns", fn = system.monotime_ns },
+  { name = "gettimespec", fn = system.gettimespec },
+  { name = "monotimespec", fn = system.monotimespec },
+  { name = "clock", fn = function() system.clock(system.CLOCK_MONOTONIC) end },
+  { name = "clock_coarse", fn = function() system.clock(system.CLOCK_MONOTONIC_COARSE) end },
+  { name = "clock_ns", fn = function() system.clock_ns(system.CLOCK_MONOTONIC) end },
+  { name = "clockspec", fn = function() system.clockspec(system.CLOCK_MONOTONIC) end },
+  { name = "clockres", fn = function() system.clockres(system.CLOCK_MONOTONIC) end },
+  { name = "sleep", fn = function() system.sleep(0) end },
+  { name = "sleep_until", fn = function() system.sleep_until(0) end },
+  { name = "sleep_precise", fn = function() system.sleep_precise(0) end },
+  { name = "gettimerslack", fn = system.gettimerslack },
+  { name = "settimerslack", fn = function() system.settimerslack(0) end },
+  { name = "timer", fn = function() system.timer(1):close() end },
+  { name = "timer_wait", fn = function() timer:wait() end },
+  { name = "cycles", fn = system.cycles },
+  { name = "cyclesrate", fn = system.cyclesrate },
+  { name = "cycles_ns", fn = function() system.cycles_ns(1000) end },
+  { name = "rusage", fn = function() system.rusage("self", usage) end },
+  { name = "formattime", fn = function() system.formattime() end },
+  { name = "formattime_os_date", fn = function()
+      -- the Lua equivalent, for comparison
+      local t = system.gettime()
+      return os.date("%Y-%m-%dT%H:%M:%S", math.floor(t)) .. string.format(".%03d", (t % 1) * 1000)
+    end },
+}
@@ -57,8 +57,11 @@ local spinner do
 end
 
 io.stdout:write("press any key to stop the spinner... ")
+local deadline = sys.monotime()
 while not spinner() do
-  sys.sleep(0.1)
+  -- sleep until an absolute deadline, so the spinner rate does not drift
+  deadline = deadline + 0.1
+  sys.sleep_until(deadline)
 end
 
 print("Done!")
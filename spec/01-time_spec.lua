@@ -1,4 +1,5 @@
 local system = require 'system.core'
+require("spec.helpers")
 
 describe('Test time functions', function()
 
@@ -43,6 +44,180 @@ describe('Test time functions', function()
 
 
 
+  describe("gettime_ns()", function()
+
+    it('returns current time in nanoseconds', function()
+      local ns = system.gettime_ns()
+      assert.is.near(system.gettime(), ns / 1e9, 0.1)
+    end)
+
+
+    it('returns an integer on Lua versions with 64-bit integers', function()
+      if not math.type then
+        return -- Lua < 5.3
+      end
+      assert.are.equal("integer", math.type(system.gettime_ns()))
+    end)
+
+  end)
+
+
+
+  describe("monotime_ns()", function()
+
+    it('returns monotonically increasing time', function()
+      local starttime = system.monotime_ns()
+      local endtime = system.monotime_ns()
+      assert.is_true(starttime > 0)
+      assert.is_true(endtime - starttime >= 0)
+    end)
+
+
+    -- Windows uses different clock sources for both
+    nix_it('matches monotime()', function()
+      assert.is.near(system.monotime(), system.monotime_ns() / 1e9, 0.1)
+    end)
+
+  end)
+
+
+
+  describe("gettimespec()", function()
+
+    it('returns seconds and nanoseconds', function()
+      local sec, nsec = system.gettimespec()
+      assert.is.near(system.gettime(), sec + nsec / 1e9, 0.1)
+      assert.are.equal(sec, math.floor(sec))
+      assert.are.equal(nsec, math.floor(nsec))
+      assert.is_true(nsec >= 0 and nsec < 1e9)
+    end)
+
+  end)
+
+
+
+  describe("monotimespec()", function()
+
+    it('returns seconds and nanoseconds', function()
+      local sec, nsec = system.monotimespec()
+      assert.is.near(system.monotime_ns() / 1e9, sec + nsec / 1e9, 0.1)
+      assert.are.equal(sec, math.floor(sec))
+      assert.are.equal(nsec, math.floor(nsec))
+      assert.is_true(nsec >= 0 and nsec < 1e9)
+    end)
+
+  end)
+
+
+
+  describe("clock()", function()
+
+    local clocks = {
+      "CLOCK_REALTIME",
+      "CLOCK_MONOTONIC",
+      "CLOCK_MONOTONIC_RAW",
+      "CLOCK_MONOTONIC_COARSE",
+      "CLOCK_REALTIME_COARSE",
+      "CLOCK_BOOTTIME",
+      "CLOCK_PROCESS_CPUTIME_ID",
+      "CLOCK_THREAD_CPUTIME_ID",
+    }
+
+    it('exports the clock constants', function()
+      for _, name in ipairs(clocks) do
+        assert.is.number(system[name], name)
+      end
+    end)
+
+
+    it('reads all available clocks', function()
+      for _, name in ipairs(clocks) do
+        if system[name] ~= -1 then
+          local t, err = system.clock(system[name])
+          assert.is_nil(err, name)
+          assert.is.number(t, name)
+          assert.is_true(t >= 0, name)
+        end
+      end
+    end)
+
+
+    it('returns the same time as gettime() and monotime()', function()
+      assert.is.near(system.gettime(), system.clock(system.CLOCK_REALTIME), 0.1)
+      assert.is.near(system.monotime_ns() / 1e9, system.clock(system.CLOCK_MONOTONIC), 0.1)
+    end)
+
+
+    it('returns an error for an unsupported clock', function()
+      local t, err = system.clock(-1)
+      assert.is_nil(t)
+      assert.are.equal("clock not supported", err)
+    end)
+
+
+    it('measures CPU time', function()
+      local t0 = system.clock(system.CLOCK_PROCESS_CPUTIME_ID)
+      local t1 = system.clock(system.CLOCK_PROCESS_CPUTIME_ID)
+      while t1 - t0 < 0.05 do
+        t1 = system.clock(system.CLOCK_PROCESS_CPUTIME_ID)
+      end
+      assert.is_true(t1 > t0)
+    end)
+
+  end)
+
+
+
+  describe("clock_ns()", function()
+
+    it('returns nanoseconds', function()
+      local ns = system.clock_ns(system.CLOCK_REALTIME)
+      assert.is.near(system.gettime(), ns / 1e9, 0.1)
+    end)
+
+
+    it('returns an error for an unsupported clock', function()
+      local t, err = system.clock_ns(-1)
+      assert.is_nil(t)
+      assert.are.equal("clock not supported", err)
+    end)
+
+  end)
+
+
+
+  describe("clockspec()", function()
+
+    it('returns seconds and nanoseconds', function()
+      local sec, nsec = system.clockspec(system.CLOCK_REALTIME)
+      assert.is.near(system.gettime(), sec + nsec / 1e9, 0.1)
+      assert.is_true(nsec >= 0 and nsec < 1e9)
+    end)
+
+  end)
+
+
+
+  describe("clockres()", function()
+
+    it('returns the clock resolution', function()
+      local res, err = system.clockres(system.CLOCK_MONOTONIC)
+      assert.is_nil(err)
+      assert.is_true(res > 0)
+      assert.is_true(res < 1)
+    end)
+
+
+    it('returns an error for an unsupported clock', function()
+      local res, err = system.clockres(-1)
+      assert.is_nil(res)
+      assert.are.equal("clock not supported", err)
+    end)
+
+  end)
+
+
+
   describe("sleep()", function()
 
     it("should sleep for the specified time", function()
@@ -73,4 +248,301 @@ describe('Test time functions', function()
 
   end)
 
+
+
+  describe("sleep_until()", function()
+
+    it("should sleep until the deadline", function()
+      local deadline = system.monotime() + 0.5
+      assert.is_true(system.sleep_until(deadline, 1))
+      local late = system.monotime() - deadline
+      assert.is_true(late >= -0.02) -- Windows monotime has a 15ms granularity
+      assert.is_true(late < 0.2)    -- large marging of error due to CI priorities
+    end)
+
+
+    it("should return immediately for a deadline in the past", function()
+      local start_time = system.monotime()
+      assert.is_true(system.sleep_until(start_time - 1))
+      assert.is_true(system.sleep_until(-1))
+      assert.is.near(0, system.monotime() - start_time, 0.01)
+    end)
+
+
+    it("should not drift in a periodic loop", function()
+      local interval = 0.01
+      local start_time = system.monotime()
+      local deadline = start_time
+      for _ = 1, 20 do
+        deadline = deadline + interval
+        system.sleep_until(deadline, 1)
+      end
+      local elapsed_time = system.monotime() - start_time
+      assert.is.near(20 * interval, elapsed_time, 0.1) -- large marging of error due to CI priorities
+    end)
+
+  end)
+
+
+
+  describe("timer()", function()
+
+    it("should tick at the interval", function()
+      local timer = assert(system.timer(0.05))
+      local start_time = system.monotime()
+      local ticks = 0
+      while ticks < 4 do
+        ticks = ticks + 1 + assert(timer:wait())
+      end
+      local elapsed_time = system.monotime() - start_time
+      assert.is.near(0.2, elapsed_time, 0.1) -- large marging of error due to CI priorities
+      timer:close()
+    end)
+
+
+    it("should honour the initial delay", function()
+      local timer = assert(system.timer(10, 0))
+      local start_time = system.monotime()
+      assert.are.equal(0, timer:wait())
+      assert.is.near(0, system.monotime() - start_time, 0.05)
+      timer:close()
+    end)
+
+
+    it("should report missed ticks", function()
+      local timer = assert(system.timer(0.01))
+      system.sleep(0.1, 1)
+      local missed = timer:wait()
+      assert.is_true(missed >= 5)
+      timer:close()
+    end)
+
+
+    it("should error on a bad interval", function()
+      assert.has_error(function() system.timer(0) end)
+      assert.has_error(function() system.timer(-1) end)
+      assert.has_error(function() system.timer(1, -1) end)
+    end)
+
+
+    it("should not be usable after closing", function()
+      local timer = assert(system.timer(1))
+      assert.is_true(timer:close())
+      assert.has_error(function() timer:wait() end)
+    end)
+
+
+    it("should expose a file descriptor on Linux", function()
+      local timer = assert(system.timer(1))
+      local fd = timer:fd()
+      local linux = io.open("/proc/self/status") ~= nil
+      if linux then
+        assert.is.number(fd)
+      else
+        assert.is_nil(fd)
+      end
+      timer:close()
+    end)
+
+  end)
+
+
+
+  describe("sleep_precise()", function()
+
+    -- returns the sorted overshoots of a number of sleeps
+    local function overshoots(fsleep, duration, count)
+      local result = {}
+      for i = 1, count do
+        local start_time = system.monotime_ns()
+        fsleep(duration)
+        result[i] = (system.monotime_ns() - start_time) / 1e9 - duration
+      end
+      table.sort(result)
+      return result
+    end
+
+
+    it("should sleep for the specified time", function()
+      local start_time = system.monotime_ns()
+      assert.is_true(system.sleep_precise(0.1))
+      local elapsed_time = (system.monotime_ns() - start_time) / 1e9
+      assert.is_true(elapsed_time >= 0.1)
+      assert.is.near(0.1, elapsed_time, 0.05)
+    end)
+
+
+    it("should return immediately for a non-positive sleep time", function()
+      local start_time = system.monotime_ns()
+      assert.is_true(system.sleep_precise(-1))
+      assert.is.near(0, (system.monotime_ns() - start_time) / 1e9, 0.01)
+    end)
+
+
+    it("should overshoot less than a regular sleep", function()
+      local count = 25
+      local regular = overshoots(system.sleep, 0.002, count)
+      local precise = overshoots(system.sleep_precise, 0.002, count)
+      local median = math.floor(count / 2) + 1
+      assert.is_true(precise[1] >= 0) -- never undershoots
+      assert.is_true(precise[median] <= regular[median],
+        ("median overshoot; precise: %.1f us, regular: %.1f us"):format(precise[median] * 1e6, regular[median] * 1e6))
+    end)
+
+  end)
+
+
+
+  describe("settimerslack()", function()
+
+    it("should set the timer slack", function()
+      local slack = assert(system.gettimerslack())
+      assert.is_true(system.settimerslack(1000))
+      if slack ~= 0 then -- Linux only
+        assert.are.equal(1000, system.gettimerslack())
+      end
+      assert.is_true(system.settimerslack(slack))
+    end)
+
+
+    it("should error on a negative slack", function()
+      assert.has_error(function() system.settimerslack(-1) end)
+    end)
+
+  end)
+
+
+
+  describe("cycles()", function()
+
+    it("returns an increasing counter", function()
+      local c0 = system.cycles()
+      local c1 = system.cycles()
+      assert.is.number(c0)
+      assert.is_true(c1 >= c0)
+    end)
+
+
+    it("is calibrated against the monotonic clock", function()
+      local rate, source = system.cyclesrate()
+      assert.is_true(rate > 0)
+      assert.is.string(source)
+
+      local t0, c0 = system.monotime_ns(), system.cycles()
+      system.sleep(0.1, 1)
+      local t1, c1 = system.monotime_ns(), system.cycles()
+      assert.is.near(t1 - t0, system.cycles_ns(c1 - c0), 0.01 * 1e9)
+    end)
+
+  end)
+
+
+
+  describe("rusage()", function()
+
+    local fields = { "utime", "stime", "maxrss", "minflt", "majflt", "nvcsw", "nivcsw" }
+
+    it("returns the resource usage of the process", function()
+      local usage = assert(system.rusage())
+      for _, field in ipairs(fields) do
+        assert.is.number(usage[field], field)
+        assert.is_true(usage[field] >= 0, field)
+      end
+      assert.is_true(usage.utime + usage.stime > 0)
+    end)
+
+
+    it("fills a given table", function()
+      local tbl = {}
+      local usage = assert(system.rusage("self", tbl))
+      assert.are.equal(tbl, usage)
+      local cpu = tbl.utime + tbl.stime
+      local t0 = system.monotime()
+      while system.monotime() - t0 < 0.05 do end -- burn some CPU
+      system.rusage("self", tbl)
+      assert.is_true(tbl.utime + tbl.stime > cpu)
+    end)
+
+
+    nix_it("returns the resource usage of children", function()
+      local usage = assert(system.rusage("children"))
+      assert.is.number(usage.utime)
+    end)
+
+
+    it("returns the resource usage of the thread, or an error", function()
+      local usage, err = system.rusage("thread")
+      if usage then
+        assert.is.number(usage.utime)
+      else
+        assert.are.equal("not supported", err)
+      end
+    end)
+
+
+    it("errors on a bad argument", function()
+      assert.has_error(function() system.rusage("parent") end)
+      assert.has_error(function() system.rusage("self", 42) end)
+    end)
+
+  end)
+
+
+
+  describe("formattime()", function()
+
+    it("formats UTC times", function()
+      assert.are.equal("1970-01-01T00:00:01Z", system.formattime(1.5, "rfc3339", true))
+      assert.are.equal("1970-01-01T00:00:01.500Z", system.formattime(1.5, "rfc3339ms", true))
+      assert.are.equal("1970-01-01T00:00:01.500000Z", system.formattime(1.5, "rfc3339us", true))
+      assert.are.equal("1970-01-01T00:00:01.500000000Z", system.formattime(1.5, "rfc3339ns", true))
+      assert.are.equal("19700101T000001Z", system.formattime(1.5, "iso8601", true))
+      assert.are.equal("19700101T000001.500Z", system.formattime(1.5, "iso8601ms", true))
+      assert.are.equal("19700101T000001.500000Z", system.formattime(1.5, "iso8601us", true))
+      assert.are.equal("19700101T000001.500000000Z", system.formattime(1.5, "iso8601ns", true))
+    end)
+
+
+    it("defaults to the current time in rfc3339ms format", function()
+      local t = system.gettime()
+      local result = system.formattime()
+      assert.matches("^%d%d%d%d%-%d%d%-%d%dT%d%d:%d%d:%d%d%.%d%d%d[%+%-]%d%d:%d%d$", result)
+      if result:sub(1, 19) ~= os.date("%Y-%m-%dT%H:%M:%S", math.floor(t)) then
+        -- second rolled over
+        assert.are.equal(os.date("%Y-%m-%dT%H:%M:%S", math.floor(t) + 1), result:sub(1, 19))
+      end
+    end)
+
+
+    it("formats local times with the UTC offset", function()
+      local t = 1700000000.25
+      local result = system.formattime(t, "rfc3339ms")
+      assert.are.equal(os.date("%Y-%m-%dT%H:%M:%S", 1700000000) .. ".250", result:sub(1, 23))
+      assert.matches("[%+%-]%d%d:%d%d$", result)
+      local basic = system.formattime(t, "iso8601ms")
+      assert.matches("[%+%-]%d%d%d%d$", basic)
+    end)
+
+
+    it("formats multiple times within the same second", function()
+      assert.are.equal("2023-11-14T22:13:20.100Z", system.formattime(1700000000.1, nil, true))
+      assert.are.equal("2023-11-14T22:13:20.900Z", system.formattime(1700000000.9, nil, true))
+      assert.are.equal("2023-11-14T22:13:21.000Z", system.formattime(1700000001, nil, true))
+      assert.are.equal("2023-11-14T22:13:20.123Z", system.formattime(1700000000.123, nil, true))
+      assert.are.equal("2023-11-14T22:13:20.001Z", system.formattime(1700000000.001, nil, true))
+      assert.are.equal("2023-11-14T22:13:20.250000Z", system.formattime(1700000000.25, "rfc3339us", true))
+    end)
+
+
+    nix_it("formats times before the epoch", function()
+      assert.are.equal("1969-12-31T23:59:59.500Z", system.formattime(-0.5, "rfc3339ms", true))
+    end)
+
+
+    it("errors on a bad format", function()
+      assert.has_error(function() system.formattime(0, "%Y") end)
+    end)
+
+  end)
+
 end)
@@ -42,6 +42,256 @@ describe("Random:", function()
       assert.is_not.equal(result1, result2)
     end)
 
+
+    it("should return large results", function()
+      -- larger than the chunk size (1 MiB), and not a multiple of it
+      local num_bytes = 3 * 1024 * 1024 + 7
+      local result, err_msg = system.random(num_bytes)
+      assert.is_nil(err_msg)
+      assert.are.equal(num_bytes, #result)
+      -- the last chunk was filled
+      assert.is_not.equal(("\0"):rep(1024), result:sub(-1024, -1))
+    end)
+
+  end)
+
+
+
+  describe("fastrandom()", function()
+
+    it("should return random bytes for a valid number of bytes", function()
+      for _, num_bytes in ipairs { 1, 16, 983, 984, 985, 1024, 5000 } do
+        local result, err_msg = system.fastrandom(num_bytes)
+        assert.is_nil(err_msg)
+        assert.is.string(result)
+        assert.is_equal(num_bytes, #result)
+      end
+    end)
+
+
+    it("should default to 1 byte", function()
+      assert.is_equal(1, #system.fastrandom())
+    end)
+
+
+    it("should return an empty string for 0 bytes", function()
+      assert.are.equal("", system.fastrandom(0))
+    end)
+
+
+    it("should return an error message for an invalid number of bytes", function()
+      local result, err_msg = system.fastrandom(-1)
+      assert.is.falsy(result)
+      assert.are.equal("invalid number of bytes, must not be less than 0", err_msg)
+    end)
+
+
+    it("should not return duplicate results", function()
+      local seen = {}
+      for _ = 1, 1000 do
+        local result = system.fastrandom(16)
+        assert.is_nil(seen[result])
+        seen[result] = true
+      end
+    end)
+
+
+    it("should keep working across reseeds", function()
+      -- reseeds every MiB
+      local result1 = system.fastrandom(3 * 1024 * 1024)
+      local result2 = system.fastrandom(3 * 1024 * 1024)
+      assert.are.equal(3 * 1024 * 1024, #result1)
+      assert.is_not.equal(result1, result2)
+    end)
+
+
+    it("should return evenly distributed bytes", function()
+      local counts = {}
+      local data = system.fastrandom(256 * 1000)
+      for i = 1, #data do
+        local b = data:byte(i)
+        counts[b] = (counts[b] or 0) + 1
+      end
+      for b = 0, 255 do
+        -- expected 1000, stddev ~31.6
+        assert.is_true(counts[b] > 800 and counts[b] < 1200)
+      end
+    end)
+
+  end)
+
+
+
+  describe("randomints()", function()
+
+    it("should return a table with integers in the range", function()
+      local result = assert(system.randomints(1000, -2, 2))
+      assert.are.equal(1000, #result)
+      local seen = {}
+      for _, value in ipairs(result) do
+        assert.is_true(value >= -2 and value <= 2)
+        assert.are.equal(math.floor(value), value)
+        seen[value] = true
+      end
+      for value = -2, 2 do
+        assert.is_true(seen[value])
+      end
+    end)
+
+
+    it("should fill an existing table", function()
+      local tbl = { "a", "b", "c", x = "y" }
+      local result = assert(system.randomints(2, 5, 5, tbl))
+      assert.are.equal(tbl, result)
+      assert.are.same({ 5, 5, "c", x = "y" }, tbl)
+    end)
+
+
+    it("should return an empty table for 0 integers", function()
+      assert.are.same({}, system.randomints(0, 1, 10))
+    end)
+
+
+    it("should error on bad arguments", function()
+      assert.has_error(function() system.randomints(-1, 1, 10) end)
+      assert.has_error(function() system.randomints(1, 10, 1) end)
+      assert.has_error(function() system.randomints(1, 1, 10, "table") end)
+    end)
+
+  end)
+
+
+
+  describe("randompacked()", function()
+
+    it("should return packed values of the right size", function()
+      assert.are.equal(40, #system.randompacked(10, "i4"))
+      assert.are.equal(80, #system.randompacked(10, "i8"))
+      assert.are.equal(80, #system.randompacked(10, "d"))
+      assert.are.equal(0, #system.randompacked(0, "i4"))
+    end)
+
+
+    it("should pack little endian values in the range", function()
+      if not string.unpack then
+        return  -- no string.unpack before Lua 5.3
+      end
+      local data = system.randompacked(1000, "i4", -3, 3)
+      for i = 1, #data, 4 do
+        local value = string.unpack("<i4", data, i)
+        assert.is_true(value >= -3 and value <= 3)
+      end
+
+      data = system.randompacked(1000, "i8", 100, 200)
+      for i = 1, #data, 8 do
+        local value = string.unpack("<i8", data, i)
+        assert.is_true(value >= 100 and value <= 200)
+      end
+
+      data = system.randompacked(1000, "d", 5, 6)
+      for i = 1, #data, 8 do
+        local value = string.unpack("<d", data, i)
+        assert.is_true(value >= 5 and value < 6)
+      end
+    end)
+
+
+    it("should error on bad arguments", function()
+      assert.has_error(function() system.randompacked(1, "i2") end)
+      assert.has_error(function() system.randompacked(-1, "i4") end)
+      assert.has_error(function() system.randompacked(1, "i4", 0, 2^31) end)
+      assert.has_error(function() system.randompacked(1, "d", 1, 1) end)
+    end)
+
+  end)
+
+
+
+  describe("uuid4()", function()
+
+    local pattern = "^%x%x%x%x%x%x%x%x%-%x%x%x%x%-4%x%x%x%-[89ab]%x%x%x%-%x%x%x%x%x%x%x%x%x%x%x%x$"
+
+    it("should return a version 4 uuid", function()
+      local uuid = assert(system.uuid4())
+      assert.matches(pattern, uuid)
+      assert.are.equal(uuid:lower(), uuid)
+    end)
+
+
+    it("should not return duplicates", function()
+      local seen = {}
+      for _ = 1, 1000 do
+        local uuid = system.uuid4()
+        assert.is_nil(seen[uuid])
+        seen[uuid] = true
+      end
+    end)
+
+  end)
+
+
+
+  describe("uuid7()", function()
+
+    local pattern = "^%x%x%x%x%x%x%x%x%-%x%x%x%x%-7%x%x%x%-[89ab]%x%x%x%-%x%x%x%x%x%x%x%x%x%x%x%x$"
+
+    it("should return a version 7 uuid with the current time", function()
+      local before = math.floor(system.gettime() * 1000)
+      local uuid = assert(system.uuid7())
+      local after = math.floor(system.gettime() * 1000)
+      assert.matches(pattern, uuid)
+      local ms = tonumber(uuid:sub(1, 8) .. uuid:sub(10, 13), 16)
+      assert.is_true(ms >= before and ms <= after + 1)
+    end)
+
+
+    it("should return increasing uuids", function()
+      local last = system.uuid7()
+      for _ = 1, 10000 do
+        local uuid = system.uuid7()
+        assert.is_true(uuid > last)
+        last = uuid
+      end
+    end)
+
+  end)
+
+
+
+  describe("uuids()", function()
+
+    it("should return a table of version 4 uuids", function()
+      local result = assert(system.uuids(5000))
+      assert.are.equal(5000, #result)
+      local seen = {}
+      for _, uuid in ipairs(result) do
+        assert.matches("^%x+%-%x+%-4%x+%-[89ab]%x+%-%x+$", uuid)
+        assert.is_nil(seen[uuid])
+        seen[uuid] = true
+      end
+    end)
+
+
+    it("should return increasing version 7 uuids", function()
+      local result = assert(system.uuids(5000, 7))
+      for i = 2, #result do
+        assert.matches("^%x+%-%x+%-7%x+%-[89ab]%x+%-%x+$", result[i])
+        assert.is_true(result[i] > result[i - 1])
+      end
+    end)
+
+
+    it("should return an empty table for 0 uuids", function()
+      assert.are.same({}, system.uuids(0))
+    end)
+
+
+    it("should error on bad arguments", function()
+      assert.has_error(function() system.uuids(-1) end)
+      assert.has_error(function() system.uuids(1, 5) end)
+    end)
+
   end)
 
 end)
+
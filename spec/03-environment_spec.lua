@@ -76,6 +76,415 @@ describe("Environment Variables:", function()
       }, envVars2)
     end)
 
+
+    it("should return a new table on every call", function()
+      assert.are_not.equal(system.getenvs(), system.getenvs())
+    end)
+
+
+    it("should update a given table in place", function()
+      assert.is_true(system.setenv("TEST_VAR1", "test_value1"))
+      local env = { NOT_AN_ENV_VAR = "value" }
+      local result, changed = system.getenvs(env)
+      assert.are.equal(env, result)
+      assert.is_true(changed)
+      assert.are.same(system.getenvs(), env)
+      assert.are.equal("test_value1", env.TEST_VAR1)
+      assert.is_nil(env.NOT_AN_ENV_VAR)
+    end)
+
+
+    it("should not change the table if setenv was not called", function()
+      local env = system.getenvs({})
+      local result, changed = system.getenvs(env)
+      assert.are.equal(env, result)
+      assert.is_false(changed)
+
+      env.MANUAL = "value"  -- not noticed, since the environment did not change
+      result, changed = system.getenvs(env)
+      assert.is_false(changed)
+      assert.are.equal("value", env.MANUAL)
+
+      result, changed = system.getenvs(env, true)  -- unless forced
+      assert.is_true(changed)
+      assert.is_nil(env.MANUAL)
+    end)
+
+
+    it("should track setenv changes", function()
+      assert.is_true(system.setenv("TEST_VAR1", "test_value1"))
+      assert.is_true(system.setenv("TEST_VAR2", "test_value2"))
+      local env = system.getenvs({})
+
+      assert.is_true(system.setenv("TEST_VAR1", "changed"))
+      assert.is_true(system.setenv("TEST_VAR2", nil))
+      local _, changed = system.getenvs(env)
+      assert.is_true(changed)
+      assert.are.equal("changed", env.TEST_VAR1)
+      assert.is_nil(env.TEST_VAR2)
+
+      -- setting the same value again
+      assert.is_true(system.setenv("TEST_VAR1", "changed"))
+      _, changed = system.getenvs(env)
+      assert.is_false(changed)
+
+      assert.is_true(system.setenv("TEST_VAR1", nil))
+    end)
+
+
+    it("should error on a bad table", function()
+      assert.has_error(function() system.getenvs(true) end)
+    end)
+
+
+    it("should filter by prefix", function()
+      assert.is_true(system.setenv("TEST_PREFIX_A", "a"))
+      assert.is_true(system.setenv("TEST_PREFIX_B", "b"))
+      assert.is_true(system.setenv("TEST_PREFIXB", "c"))
+      assert.are.same({
+        TEST_PREFIX_A = "a",
+        TEST_PREFIX_B = "b",
+      }, system.getenvs("TEST_PREFIX_"))
+      assert.are.same({}, system.getenvs("TEST_PREFIX_NONE_"))
+      assert.are.same(system.getenvs(), system.getenvs(""))
+      assert.is_true(system.setenv("TEST_PREFIX_A", nil))
+      assert.is_true(system.setenv("TEST_PREFIX_B", nil))
+      assert.is_true(system.setenv("TEST_PREFIXB", nil))
+    end)
+
+  end)
+
+
+
+  describe("envpairs()", function()
+
+    it("should iterate over all variables", function()
+      local result = {}
+      for name, value in system.envpairs() do
+        assert.is_nil(result[name])
+        result[name] = value
+      end
+      assert.are.same(system.getenvs(), result)
+    end)
+
+
+    it("should filter by prefix", function()
+      assert.is_true(system.setenv("TEST_PREFIX_A", "a"))
+      assert.is_true(system.setenv("TEST_PREFIX_B", "b"))
+      local result = {}
+      for name, value in system.envpairs("TEST_PREFIX_") do
+        result[name] = value
+      end
+      assert.are.same({
+        TEST_PREFIX_A = "a",
+        TEST_PREFIX_B = "b",
+      }, result)
+      assert.is_true(system.setenv("TEST_PREFIX_A", nil))
+      assert.is_true(system.setenv("TEST_PREFIX_B", nil))
+    end)
+
+
+    it("should return nothing for an unknown prefix", function()
+      for _ in system.envpairs("TEST_PREFIX_NONE_") do
+        error("should not be called")
+      end
+    end)
+
+
+    it("should allow breaking out of the loop", function()
+      for _ = 1, 100 do
+        for name in system.envpairs() do -- luacheck: ignore
+          break
+        end
+      end
+      collectgarbage()
+    end)
+
+
+    it("should error on a bad prefix", function()
+      assert.has_error(function() system.envpairs({}) end)
+    end)
+
+  end)
+
+
+
+  describe("getenvmany()", function()
+
+    it("should return the values of the variables", function()
+      assert.is_true(system.setenv("TEST_VAR1", "test_value1"))
+      assert.is_true(system.setenv("TEST_VAR2", "test_value2"))
+      assert.is_true(system.setenv("TEST_VAR3", nil))
+      local result = system.getenvmany { "TEST_VAR1", "TEST_VAR2", "TEST_VAR3", "TEST_VAR1" }
+      assert.are.same({
+        TEST_VAR1 = "test_value1",
+        TEST_VAR2 = "test_value2",
+      }, result)
+      assert.is_true(system.setenv("TEST_VAR1", nil))
+      assert.is_true(system.setenv("TEST_VAR2", nil))
+    end)
+
+
+    it("should match getenv for many names", function()
+      local names = {}
+      for name in pairs(system.getenvs()) do
+        names[#names+1] = name
+        names[#names+1] = name .. "_NOT_SET"
+      end
+      local result = system.getenvmany(names)
+      for _, name in ipairs(names) do
+        assert.are.equal(system.getenv(name), result[name])
+      end
+    end)
+
+
+    it("should fill the given table", function()
+      assert.is_true(system.setenv("TEST_VAR1", "test_value1"))
+      assert.is_true(system.setenv("TEST_VAR2", nil))
+      local out = { TEST_VAR2 = "old", OTHER = "other" }
+      local result = system.getenvmany({ "TEST_VAR1", "TEST_VAR2" }, out)
+      assert.are.equal(out, result)
+      assert.are.same({
+        TEST_VAR1 = "test_value1",
+        OTHER = "other",
+      }, out)
+      assert.is_true(system.setenv("TEST_VAR1", nil))
+    end)
+
+
+    it("should return an empty table for no names", function()
+      assert.are.same({}, system.getenvmany {})
+    end)
+
+
+    it("should error on bad input", function()
+      assert.has_error(function() system.getenvmany("TEST_VAR1") end)
+      assert.has_error(function() system.getenvmany({ 1 }) end)
+      assert.has_error(function() system.getenvmany({}, "table") end)
+    end)
+
+  end)
+
+
+
+  describe("expandenv()", function()
+
+    before_each(function()
+      assert.is_true(system.setenv("TEST_VAR1", "value1"))
+      assert.is_true(system.setenv("TEST_VAR2", nil))
+    end)
+
+
+    after_each(function()
+      assert.is_true(system.setenv("TEST_VAR1", nil))
+    end)
+
+
+    it("should expand $NAME and ${NAME}", function()
+      assert.are.equal("a value1 b", system.expandenv("a $TEST_VAR1 b"))
+      assert.are.equal("avalue1b", system.expandenv("a${TEST_VAR1}b"))
+      assert.are.equal("value1.x", system.expandenv("$TEST_VAR1.x"))
+      assert.are.equal("", system.expandenv("$TEST_VAR1x"))
+    end)
+
+
+    it("should expand unset variables to an empty string", function()
+      assert.are.equal("[]", system.expandenv("[$TEST_VAR2]"))
+      assert.are.equal("[]", system.expandenv("[${TEST_VAR2}]"))
+    end)
+
+
+    it("should use defaults", function()
+      assert.are.equal("default", system.expandenv("${TEST_VAR2:-default}"))
+      assert.are.equal("default", system.expandenv("${TEST_VAR2-default}"))
+      assert.are.equal("value1", system.expandenv("${TEST_VAR1:-default}"))
+      assert.are.equal("value1", system.expandenv("${TEST_VAR2:-$TEST_VAR1}"))
+      assert.are.equal("<value1>", system.expandenv("${TEST_VAR2:-<${TEST_VAR3:-$TEST_VAR1}>}"))
+      assert.are.equal("", system.expandenv("${TEST_VAR2:-}"))
+    end)
+
+
+    nix_it("should only use ':-' defaults for empty values", function()
+      assert.is_true(system.setenv("TEST_VAR2", ""))
+      assert.are.equal("default", system.expandenv("${TEST_VAR2:-default}"))
+      assert.are.equal("", system.expandenv("${TEST_VAR2-default}"))
+      assert.is_true(system.setenv("TEST_VAR2", nil))
+    end)
+
+
+    it("should handle escapes and lone '$'", function()
+      assert.are.equal("$TEST_VAR1", system.expandenv("$$TEST_VAR1"))
+      assert.are.equal("$", system.expandenv("$"))
+      assert.are.equal("5$ and $1", system.expandenv("5$ and $1"))
+      assert.are.equal("${x}", system.expandenv("${TEST_VAR2:-$${x}}"))
+    end)
+
+
+    it("should use overrides before the environment", function()
+      local overrides = { TEST_VAR1 = "override", TEST_VAR2 = 42, TEST_VAR3 = false }
+      assert.is_true(system.setenv("TEST_VAR3", "value3"))
+      assert.are.equal("override 42 default",
+        system.expandenv("$TEST_VAR1 $TEST_VAR2 ${TEST_VAR3:-default}", overrides))
+      assert.is_true(system.setenv("TEST_VAR3", nil))
+    end)
+
+
+    it("should return an error on bad syntax", function()
+      for _, str in ipairs { "${TEST_VAR1", "${}", "${1}", "${TEST_VAR1:x}", "${TEST_VAR2:-${x}" } do
+        local result, err = system.expandenv(str)
+        assert.is_nil(result)
+        assert.is.string(err)
+      end
+    end)
+
+
+    it("should error on bad arguments", function()
+      assert.has_error(function() system.expandenv({}) end)
+      assert.has_error(function() system.expandenv("", "table") end)
+    end)
+
+  end)
+
+
+
+  describe("sharedenv()", function()
+
+    -- enabling is process-wide and permanent, so the tests run in a new process, to keep
+    -- the busted process (and the tests in other files) on the regular environment
+    local function shared(code)
+      local lua_bin = system.getenv("LUA") or "lua"
+      local script = require("pl.path").tmpname()
+      local f = assert(io.open(script, "wb"))
+      f:write(("package.path = %q\npackage.cpath = %q\n"):format(package.path, package.cpath))
+      f:write('local sys = require("system")\n', code, '\nio.write("ok")\n')
+      f:close()
+      local p = assert(io.popen(lua_bin .. ' "' .. script .. '" 2>&1'))
+      local output = p:read("*a")
+      p:close()
+      os.remove(script)
+      assert.are.equal("ok", output)
+    end
+
+
+    it("should enable the shared environment", function()
+      shared([[
+        assert(sys.sharedenv() == false)
+        assert(sys.sharedenv(true) == true)
+        assert(sys.sharedenv() == true)
+        assert(sys.sharedenv(true) == true)
+      ]])
+      assert.is_false(system.sharedenv())
+    end)
+
+
+    it("should not be disabled", function()
+      shared([[
+        sys.sharedenv(true)
+        assert(not pcall(sys.sharedenv, false), "disabled")
+        assert(sys.sharedenv() == true)
+      ]])
+    end)
+
+
+    it("should error on bad arguments", function()
+      assert.has_error(function() system.sharedenv("yes") end)
+      assert.is_false(system.sharedenv())
+    end)
+
+
+    it("should read and write the environment", function()
+      shared([[
+        sys.sharedenv(true)
+        assert(sys.setenv("TEST_VAR1", "shared"))
+        assert(sys.getenv("TEST_VAR1") == "shared")
+        assert(sys.getenvs().TEST_VAR1 == "shared")
+        assert(sys.getenvmany({ "TEST_VAR1" }).TEST_VAR1 == "shared")
+        assert(sys.expandenv("[$TEST_VAR1]") == "[shared]")
+        assert(sys.setenv("TEST_VAR1", nil))
+        assert(sys.getenv("TEST_VAR1") == nil)
+        assert(sys.getenvs().TEST_VAR1 == nil)
+      ]])
+    end)
+
+
+    it("should update tables with getenvs", function()
+      shared([[
+        sys.sharedenv(true)
+        local env = sys.getenvs({})
+        assert(sys.setenv("TEST_VAR1", "value1"))
+        local _, changed = sys.getenvs(env)
+        assert(changed == true, "not changed")
+        assert(env.TEST_VAR1 == "value1")
+        assert(sys.setenv("TEST_VAR1", nil))
+        sys.getenvs(env)
+        assert(env.TEST_VAR1 == nil)
+      ]])
+    end)
+
+
+    it("should iterate a fixed copy with envpairs", function()
+      shared([[
+        sys.sharedenv(true)
+        assert(sys.setenv("TEST_VAR1", "before"))
+        local seen
+        for _, value in sys.envpairs("TEST_VAR1") do
+          assert(sys.setenv("TEST_VAR1", "after"))
+          seen = value
+        end
+        assert(seen == "before", "iteration not fixed")
+        assert(sys.getenv("TEST_VAR1") == "after")
+        assert(sys.setenv("TEST_VAR1", nil))
+      ]])
+    end)
+
+
+    describe("with threads", function()
+
+      -- every lane is an OS thread with its own Lua state, like worker threads in a host
+      local has_lanes = pcall(require, "lanes")
+      local lanes_it = has_lanes and it or function(desc, ...)
+        return pending(desc .. " [requires 'lanes']", ...)
+      end
+
+      lanes_it("should survive concurrent reads and writes", function()
+        shared([[
+          sys.sharedenv(true)
+          local lanes = require("lanes")
+          lanes = lanes.configure and lanes.configure() or lanes
+          local worker = lanes.gen("*", function(id, count)
+            local sys = require("system")
+            sys.sharedenv(true)
+            local name = "LUASYSTEM_STRESS_" .. id
+            local env = {}
+            for i = 1, count do
+              assert(sys.setenv(name, tostring(i)))
+              assert(sys.getenv(name) == tostring(i), "own variable not set")
+              assert(sys.getenv("LUASYSTEM_STRESS"), "shared variable missing")
+              sys.getenvs(env)
+              assert(env[name] == tostring(i), "getenvs not updated")
+              assert(sys.expandenv("$" .. name) == tostring(i))
+              for _ in sys.envpairs("LUASYSTEM_STRESS") do end
+            end
+            assert(sys.setenv(name, nil))
+            return true
+          end)
+
+          assert(sys.setenv("LUASYSTEM_STRESS", "1"))
+          local threads = {}
+          for id = 1, 8 do
+            threads[id] = worker(id, 2000)
+          end
+          for id = 1, 8 do
+            assert(threads[id][1] == true)  -- waits for the lane, and raises its error if it failed
+          end
+          assert(sys.setenv("LUASYSTEM_STRESS", nil))
+          assert(next(sys.getenvs("LUASYSTEM_STRESS")) == nil)
+        ]])
+      end)
+
+    end)
+
   end)
 
 end)
+
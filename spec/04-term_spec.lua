@@ -828,6 +828,9 @@ describe("Terminal:", function()
     local current_buffer
     local function setbuffer(str)
       assert(type(str) == "string", "setbuffer() expects a string")
+      -- readansi parses in C, so also put the input in the C input buffer (replacing
+      -- what is left there, without reading the real stdin)
+      system._unreadbytes(str, true)
       if str == "" then
         current_buffer = nil
       else
@@ -836,9 +839,15 @@ describe("Terminal:", function()
     end
 
 
+    local readkey_timeout  -- the timeout passed to the last _readkey call
+
     setup(function()
-      system._readkey = function()
+      system._readkey = function(timeout)
+        readkey_timeout = timeout
         if not current_buffer then
+          if timeout and timeout > 0 then
+            system.sleep(timeout)  -- like the C version, wait for the timeout
+          end
           return nil
         end
         local ch = current_buffer:byte(1, 1)
@@ -899,6 +908,22 @@ describe("Terminal:", function()
       end)
 
 
+      nix_it("waits in C with the exact timeout, without fsleep", function()
+        setbuffer("")
+        readkey_timeout = nil
+        assert.same({ nil, "timeout" }, { system.readkey(0.05) })
+        assert.equals(0.05, readkey_timeout)
+      end)
+
+
+      it("does not pass the timeout to C, with fsleep", function()
+        setbuffer("")
+        readkey_timeout = 1
+        system.readkey(0.01, function() return true end)
+        assert.is_nil(readkey_timeout)
+      end)
+
+
       it("calls flseep to execute the sleep", function()
         setbuffer("")
 
@@ -1033,6 +1058,95 @@ describe("Terminal:", function()
         assert.are.same({"🚀", "char"}, {system.readansi(0)})
       end)
 
+
+      it("calls fsleep to execute the sleep", function()
+        setbuffer("")
+        local sleep_called = false
+        local mysleep = function()
+          sleep_called = true
+          return true
+        end
+
+        assert.are.same({ nil, "timeout" }, { system.readansi(0.01, mysleep) })
+        assert.is_true(sleep_called)
+      end)
+
+
+      it("completes sequences when using fsleep", function()
+        setbuffer("\27[1;")
+        local mysleep = function()
+          setbuffer("5A")
+          return true
+        end
+        assert.are.same({"\27[1;5A", "ansi"}, {system.readansi(1, mysleep)})
+      end)
+
+
+      it("returns errors by fsleep, with the partial sequence", function()
+        setbuffer("\27[")
+        local mysleep = function()
+          return nil, "boom!"
+        end
+
+        assert.are.same({ nil, "boom!", "\27[" }, { system.readansi(1, mysleep) })
+        setbuffer("B")
+        assert.are.same({"\27[B", "ansi"}, {system.readansi(0)})
+      end)
+
+
+      it("returns unread input first", function()
+        setbuffer("b")
+        system._unreadbytes("a")
+        assert.are.same({"a", "char"}, {system.readansi(0)})
+        assert.are.same({"b", "char"}, {system.readansi(0)})
+      end)
+
+    end)
+
+  end)
+
+
+
+  describe("readbytes()", function()
+
+    -- runs the Lua code in a new process, with 'input' piped into stdin
+    local function piped(input, code)
+      local lua_bin = system.getenv("LUA") or "lua"
+      local cmd = "printf '" .. input .. "' | " .. lua_bin .. " -e '" .. code .. "'"
+      local f = assert(io.popen(cmd))
+      local output = f:read("*a")
+      f:close()
+      return output
+    end
+
+
+    nix_it("returns all pending input", function()
+      assert.are.equal("h|ello world", piped("hello world", [[
+        local sys = require("system")
+        io.write(string.char(sys.readkey(1)), "|", sys.readbytes())
+      ]]))
+    end)
+
+
+    nix_it("returns at most 'max' bytes", function()
+      assert.are.equal("h|ell|o world", piped("hello world", [[
+        local sys = require("system")
+        io.write(string.char(sys.readkey(1)), "|", sys.readbytes(3), "|", sys.readbytes())
+      ]]))
+    end)
+
+
+    nix_it("returns nil if no input is pending", function()
+      assert.are.equal("h|ello|nil", piped("hello", [[
+        local sys = require("system")
+        io.write(string.char(sys.readkey(1)), "|", sys.readbytes(), "|", tostring(sys.readbytes()))
+      ]]))
+    end)
+
+
+    it("errors on a bad max", function()
+      assert.has.error(function() system.readbytes(0) end)
+      assert.has.error(function() system.readbytes("x") end)
     end)
 
   end)
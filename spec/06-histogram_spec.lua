@@ -0,0 +1,153 @@
+local system = require("system")
+
+describe("histogram:", function()
+
+  describe("histogram()", function()
+
+    it("should create a histogram", function()
+      local hist = system.histogram()
+      assert.are.equal(0, hist:count())
+      assert.are.equal(0, hist:percentile(50))
+      assert.are.equal("histogram: 0 values", tostring(hist))
+    end)
+
+
+    it("should error on an invalid precision", function()
+      assert.has_error(function() system.histogram(1) end)
+      assert.has_error(function() system.histogram(13) end)
+    end)
+
+  end)
+
+
+
+  describe("record()", function()
+
+    it("should record values exactly below 2^precision", function()
+      local hist = system.histogram()
+      for i = 1, 100 do
+        hist:record(i)
+      end
+      assert.are.equal(100, hist:count())
+      assert.are.equal(1, hist:min())
+      assert.are.equal(100, hist:max())
+      assert.are.equal(50.5, hist:mean())
+      assert.are.equal(50, hist:percentile(50))
+      assert.are.equal(99, hist:percentile(99))
+      assert.are.equal(1, hist:percentile(0))
+      assert.are.equal(100, hist:percentile(100))
+    end)
+
+
+    it("should record large values within the precision", function()
+      local hist = system.histogram()
+      for i = 1, 1000 do
+        hist:record(i * 1000000)
+      end
+      local p50 = hist:percentile(50)
+      assert.is_true(math.abs(p50 - 500000000) / 500000000 < 0.016)
+      assert.are.equal(1000000, hist:min())
+      assert.are.equal(1000000000, hist:max())
+    end)
+
+
+    it("should record a value multiple times", function()
+      local hist = system.histogram()
+      hist:record(10, 5)
+      assert.are.equal(5, hist:count())
+      assert.are.equal(10, hist:percentile(50))
+    end)
+
+
+    it("should accept fractional values", function()
+      local hist = system.histogram()
+      hist:record(10.7)
+      assert.are.equal(10, hist:max())
+    end)
+
+
+    it("should error on negative values", function()
+      local hist = system.histogram()
+      assert.has_error(function() hist:record(-1) end)
+      assert.has_error(function() hist:record(1, -1) end)
+    end)
+
+  end)
+
+
+
+  describe("start()/stop()", function()
+
+    it("should record the elapsed time", function()
+      local hist = system.histogram()
+      hist:start()
+      system.sleep(0.05, 1)
+      local elapsed = hist:stop()
+      assert.is.near(0.05, elapsed / 1e9, 0.04)
+      assert.are.equal(1, hist:count())
+      assert.are.equal(elapsed, hist:max())
+    end)
+
+
+    it("should error if the stopwatch was not started", function()
+      local hist = system.histogram()
+      assert.has_error(function() hist:stop() end, "stopwatch was not started")
+    end)
+
+  end)
+
+
+
+  describe("percentile()", function()
+
+    it("should error on an invalid percentile", function()
+      local hist = system.histogram()
+      assert.has_error(function() hist:percentile(-1) end)
+      assert.has_error(function() hist:percentile(101) end)
+    end)
+
+  end)
+
+
+
+  describe("merge()", function()
+
+    it("should merge histograms", function()
+      local hist1 = system.histogram()
+      local hist2 = system.histogram()
+      hist1:record(10)
+      hist2:record(20)
+      hist2:record(30)
+      hist1:merge(hist2)
+      assert.are.equal(3, hist1:count())
+      assert.are.equal(10, hist1:min())
+      assert.are.equal(30, hist1:max())
+      assert.are.equal(20, hist1:mean())
+      assert.are.equal(2, hist2:count())
+    end)
+
+
+    it("should error on a different precision", function()
+      local hist1 = system.histogram(7)
+      local hist2 = system.histogram(8)
+      assert.has_error(function() hist1:merge(hist2) end)
+    end)
+
+  end)
+
+
+
+  describe("reset()", function()
+
+    it("should clear all values", function()
+      local hist = system.histogram()
+      hist:record(10)
+      hist:reset()
+      assert.are.equal(0, hist:count())
+      assert.are.equal(0, hist:max())
+      assert.are.equal(0, hist:percentile(99))
+    end)
+
+  end)
+
+end)
@@ -0,0 +1,61 @@
+local system = require("system")
+
+describe("bench:", function()
+
+  describe("bench()", function()
+
+    local fields = { "samples", "iterations", "total", "mean", "min", "max", "stddev", "p50", "p90", "p99" }
+
+    it("should return timing results", function()
+      local result = system.bench(function() end, { warmup = 0.01, time = 0.05 })
+      for _, field in ipairs(fields) do
+        assert.is.number(result[field], field)
+      end
+      assert.are.equal(100, result.samples)
+      assert.are.equal(result.iterations * result.samples, result.total)
+      assert.is_true(result.min <= result.p50)
+      assert.is_true(result.p50 <= result.p90)
+      assert.is_true(result.p90 <= result.p99)
+      assert.is_true(result.p99 <= result.max)
+    end)
+
+
+    it("should measure the duration of the function", function()
+      local result = system.bench(function() system.sleep(0.01, 1) end, { warmup = 0, samples = 5, iterations = 1 })
+      assert.are.equal(5, result.total)
+      assert.is.near(0.01, result.p50 / 1e9, 0.01)
+    end)
+
+
+    it("should call the function the expected number of times", function()
+      local count = 0
+      local result = system.bench(function() count = count + 1 end, { warmup = 0, samples = 10, iterations = 10 })
+      assert.are.equal(100, result.total)
+      assert.is_true(count >= 100) -- includes the warmup calls
+    end)
+
+
+    it("should ignore extra arguments", function()
+      -- the samples must stay referenced during the garbage collection before measuring
+      local result = system.bench(function() end, { warmup = 0, samples = 1000, iterations = 1 }, "extra", {})
+      assert.are.equal(1000, result.samples)
+      assert.is_true(result.min <= result.p50 and result.p50 <= result.max)
+    end)
+
+
+    it("should error on bad arguments", function()
+      assert.has_error(function() system.bench() end)
+      assert.has_error(function() system.bench(function() end, { samples = 0 }) end)
+      assert.has_error(function() system.bench(function() end, { time = "fast" }) end)
+    end)
+
+
+    it("should pass errors from the function", function()
+      assert.has_error(function()
+        system.bench(function() error("boom") end)
+      end)
+    end)
+
+  end)
+
+end)
@@ -0,0 +1,208 @@
+local system = require("system")
+
+describe("rng:", function()
+
+  describe("rng()", function()
+
+    it("should create a generator seeded from the OS", function()
+      local rng1 = assert(system.rng())
+      local rng2 = assert(system.rng())
+      assert.is_not.equal(rng1:float(), rng2:float())
+      assert.matches("^rng: ", tostring(rng1))
+    end)
+
+
+    it("should produce the same sequence for the same seed", function()
+      -- identical on every Lua version and platform
+      local rng = system.rng(42)
+      local result = {}
+      for i = 1, 5 do
+        result[i] = rng:int(1, 100)
+      end
+      assert.are.same({ 9, 38, 69, 93, 100 }, result)
+    end)
+
+
+    it("should produce the reference 64-bit output", function()
+      local rng = system.rng(42)
+      if math.type then
+        assert.are.equal(1546998764402558742, rng:int())
+      else
+        -- no 64-bit integers before Lua 5.3, so the top 53 bits
+        assert.are.equal(math.floor(1546998764402558742 / 2^11), rng:int())
+      end
+    end)
+
+  end)
+
+
+
+  describe("seed()", function()
+
+    it("should restart the sequence", function()
+      local rng = system.rng(123)
+      local first = rng:float()
+      rng:float()
+      assert.is_true(rng:seed(123))
+      assert.are.equal(first, rng:float())
+    end)
+
+
+    it("should seed from the OS without a seed", function()
+      local rng = system.rng(123)
+      local first = rng:float()
+      assert.is_true(rng:seed())
+      assert.is_not.equal(first, rng:float())
+    end)
+
+  end)
+
+
+
+  describe("int()", function()
+
+    it("should return values within the range", function()
+      local rng = system.rng(1)
+      local seen = {}
+      for _ = 1, 1000 do
+        local value = rng:int(-3, 3)
+        assert.is_true(value >= -3 and value <= 3)
+        assert.are.equal(math.floor(value), value)
+        seen[value] = true
+      end
+      for value = -3, 3 do
+        assert.is_true(seen[value])
+      end
+    end)
+
+
+    it("should default the lower bound to 1", function()
+      local rng = system.rng(1)
+      for _ = 1, 100 do
+        local value = rng:int(2)
+        assert.is_true(value == 1 or value == 2)
+      end
+    end)
+
+
+    it("should accept a single value range", function()
+      assert.are.equal(7, system.rng(1):int(7, 7))
+    end)
+
+
+    it("should error on an empty interval", function()
+      local rng = system.rng(1)
+      assert.has_error(function() rng:int(2, 1) end)
+      assert.has_error(function() rng:int(0) end)
+    end)
+
+  end)
+
+
+
+  describe("float()", function()
+
+    it("should return values in [0, 1)", function()
+      local rng = system.rng(1)
+      local sum = 0
+      for _ = 1, 10000 do
+        local value = rng:float()
+        assert.is_true(value >= 0 and value < 1)
+        sum = sum + value
+      end
+      assert.is.near(0.5, sum / 10000, 0.02)
+    end)
+
+  end)
+
+
+
+  describe("bytes()", function()
+
+    it("should return the number of bytes requested", function()
+      local rng = system.rng(1)
+      for _, n in ipairs { 0, 1, 7, 8, 9, 1000, 100000 } do
+        assert.are.equal(n, #rng:bytes(n))
+      end
+    end)
+
+
+    it("should be reproducible", function()
+      assert.are.equal(system.rng(5):bytes(33), system.rng(5):bytes(33))
+    end)
+
+
+    it("should error on a negative count", function()
+      assert.has_error(function() system.rng(1):bytes(-1) end)
+    end)
+
+  end)
+
+
+
+  describe("normal()", function()
+
+    it("should have the requested mean and standard deviation", function()
+      local rng = system.rng(1)
+      local n, sum, sumsq = 20000, 0, 0
+      for _ = 1, n do
+        local value = rng:normal(10, 2)
+        sum = sum + value
+        sumsq = sumsq + value * value
+      end
+      local mean = sum / n
+      assert.is.near(10, mean, 0.1)
+      assert.is.near(2, math.sqrt(sumsq / n - mean * mean), 0.1)
+    end)
+
+  end)
+
+
+
+  describe("exponential()", function()
+
+    it("should have a mean of 1 / rate", function()
+      local rng = system.rng(1)
+      local n, sum = 20000, 0
+      for _ = 1, n do
+        local value = rng:exponential(4)
+        assert.is_true(value >= 0)
+        sum = sum + value
+      end
+      assert.is.near(0.25, sum / n, 0.01)
+    end)
+
+
+    it("should error on a bad rate", function()
+      assert.has_error(function() system.rng(1):exponential(0) end)
+    end)
+
+  end)
+
+
+
+  describe("jump()/clone()", function()
+
+    it("should clone the state", function()
+      local rng = system.rng(9)
+      rng:float()
+      local copy = rng:clone()
+      assert.are.equal(rng:float(), copy:float())
+    end)
+
+
+    it("should jump to a different stream", function()
+      local rng = system.rng(9)
+      local copy = rng:clone()
+      copy:jump()
+      assert.is_not.equal(rng:float(), copy:float())
+      local other = system.rng(9)
+      other:jump()
+      copy = system.rng(9)
+      copy:jump()
+      assert.are.equal(other:float(), copy:float())
+    end)
+
+  end)
+
+end)
@@ -0,0 +1,125 @@
+local system = require("system")
+
+describe("buffer:", function()
+
+  describe("buffer()", function()
+
+    it("should create a zeroed buffer", function()
+      local buf = system.buffer(10)
+      assert.are.equal(10, buf:len())
+      assert.are.equal(10, #buf)
+      assert.are.equal(("\0"):rep(10), buf:tostring())
+      assert.are.equal("buffer: 10 bytes", tostring(buf))
+    end)
+
+
+    it("should create a buffer from a string", function()
+      local buf = system.buffer("hello")
+      assert.are.equal(5, #buf)
+      assert.are.equal("hello", buf:tostring())
+    end)
+
+
+    it("should create an empty buffer", function()
+      assert.are.equal("", system.buffer(0):tostring())
+    end)
+
+
+    it("should error on a negative size", function()
+      assert.has_error(function() system.buffer(-1) end)
+    end)
+
+  end)
+
+
+
+  describe("fillrandom()", function()
+
+    it("should fill the whole buffer in place", function()
+      local buf = system.buffer(1024)
+      assert.are.equal(buf, buf:fillrandom())
+      local first = buf:tostring()
+      assert.is_not.equal(("\0"):rep(1024), first)
+      buf:fillrandom()
+      assert.is_not.equal(first, buf:tostring())
+    end)
+
+
+    it("should fill a part of the buffer", function()
+      local buf = system.buffer(100)
+      buf:fillrandom(11, 20)
+      assert.are.equal(("\0"):rep(10), buf:tostring(1, 10))
+      assert.are.equal(("\0"):rep(70), buf:tostring(31))
+      assert.is_not.equal(("\0"):rep(20), buf:tostring(11, 30))
+    end)
+
+
+    it("should fill up to the end by default", function()
+      local buf = system.buffer(100)
+      buf:fillrandom(91)
+      assert.are.equal(("\0"):rep(90), buf:tostring(1, 90))
+      assert.is_not.equal(("\0"):rep(10), buf:tostring(91))
+    end)
+
+
+    it("should error on a range outside the buffer", function()
+      local buf = system.buffer(10)
+      assert.has_error(function() buf:fillrandom(0) end)
+      assert.has_error(function() buf:fillrandom(12) end)
+      assert.has_error(function() buf:fillrandom(5, 7) end)
+    end)
+
+  end)
+
+
+
+  describe("tostring()/sub()/byte()", function()
+
+    it("should use string.sub indices", function()
+      local s = "hello world"
+      local buf = system.buffer(s)
+      for _, range in ipairs { {}, {1}, {3}, {-5}, {2, 4}, {-3, -2}, {5, 2}, {0, 100}, {-100, 3} } do
+        assert.are.equal(s:sub(range[1] or 1, range[2] or -1), buf:tostring(range[1], range[2]))
+        assert.are.equal(s:sub(range[1] or 1, range[2] or -1), buf:sub(range[1], range[2]):tostring())
+      end
+    end)
+
+
+    it("should return a copy from sub()", function()
+      local buf = system.buffer("hello")
+      local copy = buf:sub(2, 3)
+      buf:write("HELLO")
+      assert.are.equal("el", copy:tostring())
+    end)
+
+
+    it("should return byte values like string.byte", function()
+      local buf = system.buffer("abc")
+      assert.are.same({ 97 }, { buf:byte() })
+      assert.are.same({ 99 }, { buf:byte(-1) })
+      assert.are.same({ 97, 98, 99 }, { buf:byte(1, -1) })
+      assert.are.same({}, { buf:byte(10) })
+    end)
+
+  end)
+
+
+
+  describe("write()", function()
+
+    it("should write at an offset", function()
+      local buf = system.buffer("hello world")
+      assert.are.equal(buf, buf:write("W", 7))
+      assert.are.equal("hello World", buf:tostring())
+    end)
+
+
+    it("should error when writing past the end", function()
+      local buf = system.buffer(4)
+      assert.has_error(function() buf:write("hello") end)
+      assert.has_error(function() buf:write("h", 5) end)
+    end)
+
+  end)
+
+end)
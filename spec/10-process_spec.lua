@@ -0,0 +1,233 @@
+local system = require("system")
+require("spec.helpers")
+
+describe("process:", function()
+
+  local tmpfile
+
+  before_each(function()
+    tmpfile = os.tmpname()
+  end)
+
+  after_each(function()
+    os.remove(tmpfile)
+  end)
+
+  local function readfile(name)
+    local f = assert(io.open(name, "rb"))
+    local content = f:read("*a")
+    f:close()
+    return content
+  end
+
+
+
+  describe("envblock()", function()
+
+    it("should create a block from a table", function()
+      local block = system.envblock({ A = "1", B = "two", C = 3 })
+      assert.are.equal(3, #block)
+      assert.are.equal("envblock: 3 variables", tostring(block))
+    end)
+
+
+    it("should create an empty block", function()
+      assert.are.equal(0, #system.envblock({}))
+    end)
+
+
+    it("should accept the current environment", function()
+      local env = system.getenvs()
+      local count = 0
+      for _ in pairs(env) do count = count + 1 end
+      assert.are.equal(count, #system.envblock(env))
+    end)
+
+
+    it("should error on invalid names", function()
+      assert.has_error(function() system.envblock({ [1] = "x" }) end)
+      assert.has_error(function() system.envblock({ [""] = "x" }) end)
+      assert.has_error(function() system.envblock({ ["A=B"] = "x" }) end)
+    end)
+
+
+    it("should error on invalid values", function()
+      assert.has_error(function() system.envblock({ A = true }) end)
+      assert.has_error(function() system.envblock({ A = {} }) end)
+    end)
+
+  end)
+
+
+
+  describe("spawn()", function()
+
+    nix_it("should return the exit code", function()
+      local pid = assert(system.spawn({ "true" }))
+      assert.are.same({ "exit", 0 }, { system.waitpid(pid) })
+
+      pid = assert(system.spawn({ "sh", "-c", "exit 3" }))
+      assert.are.same({ "exit", 3 }, { system.waitpid(pid) })
+    end)
+
+
+    nix_it("should redirect output to a file", function()
+      local pid = assert(system.spawn({ "echo", "hello", "world" }, { stdout = tmpfile }))
+      system.waitpid(pid)
+      assert.are.equal("hello world\n", readfile(tmpfile))
+    end)
+
+
+    nix_it("should redirect output to a Lua file handle", function()
+      local f = assert(io.open(tmpfile, "wb"))
+      local pid = assert(system.spawn({ "echo", "hello" }, { stdout = f }))
+      system.waitpid(pid)
+      f:close()
+      assert.are.equal("hello\n", readfile(tmpfile))
+    end)
+
+
+    nix_it("should read input from a file", function()
+      local f = assert(io.open(tmpfile, "wb"))
+      f:write("input\n")
+      f:close()
+      local out = os.tmpname()
+      local pid = assert(system.spawn({ "cat" }, { stdin = tmpfile, stdout = out }))
+      system.waitpid(pid)
+      local content = readfile(out)
+      os.remove(out)
+      assert.are.equal("input\n", content)
+    end)
+
+
+    nix_it("should discard output if set to false", function()
+      local pid = assert(system.spawn({ "echo", "hello" }, { stdout = false }))
+      assert.are.same({ "exit", 0 }, { system.waitpid(pid) })
+    end)
+
+
+    nix_it("should use a reusable environment block", function()
+      local block = system.envblock({ LUASYSTEM_SPAWN = "from block" })
+      for _ = 1, 3 do
+        local pid = assert(system.spawn({ "sh", "-c", "echo $LUASYSTEM_SPAWN" },
+                                        { env = block, stdout = tmpfile }))
+        system.waitpid(pid)
+        assert.are.equal("from block\n", readfile(tmpfile))
+      end
+    end)
+
+
+    nix_it("should use an environment table", function()
+      local pid = assert(system.spawn({ "sh", "-c", "echo $LUASYSTEM_SPAWN" },
+                                      { env = { LUASYSTEM_SPAWN = "from table" }, stdout = tmpfile }))
+      system.waitpid(pid)
+      assert.are.equal("from table\n", readfile(tmpfile))
+    end)
+
+
+    nix_it("should only pass the given environment", function()
+      system.setenv("LUASYSTEM_SPAWN_PARENT", "parent")
+      local pid = assert(system.spawn({ "sh", "-c", "echo \"[$LUASYSTEM_SPAWN_PARENT]\"" },
+                                      { env = system.envblock({}), stdout = tmpfile }))
+      system.waitpid(pid)
+      system.setenv("LUASYSTEM_SPAWN_PARENT", nil)
+      assert.are.equal("[]\n", readfile(tmpfile))
+    end)
+
+
+    nix_it("should inherit the current environment by default", function()
+      system.setenv("LUASYSTEM_SPAWN_PARENT", "parent")
+      local pid = assert(system.spawn({ "sh", "-c", "echo $LUASYSTEM_SPAWN_PARENT" }, { stdout = tmpfile }))
+      system.waitpid(pid)
+      system.setenv("LUASYSTEM_SPAWN_PARENT", nil)
+      assert.are.equal("parent\n", readfile(tmpfile))
+    end)
+
+
+    nix_it("should change the working directory", function()
+      local pid, err = system.spawn({ "pwd" }, { cwd = "/", stdout = tmpfile })
+      if not pid then
+        assert.matches("not supported", err)
+        return
+      end
+      system.waitpid(pid)
+      assert.are.equal("/\n", readfile(tmpfile))
+    end)
+
+
+    nix_it("should return an error for a missing program", function()
+      local pid, err = system.spawn({ "luasystem-does-not-exist" })
+      if pid then
+        -- some implementations report exec errors as exit code 127
+        assert.are.same({ "exit", 127 }, { system.waitpid(pid) })
+      else
+        assert.matches("luasystem%-does%-not%-exist", err)
+      end
+    end)
+
+
+    win_it("should return an error on Windows", function()
+      local pid, err = system.spawn({ "cmd" })
+      assert.is_nil(pid)
+      assert.matches("not supported", err)
+    end)
+
+
+    it("should error on bad arguments", function()
+      assert.has_error(function() system.spawn() end)
+      assert.has_error(function() system.spawn({}) end)
+      assert.has_error(function() system.spawn({ "echo", 1 }) end)
+      assert.has_error(function() system.spawn({ "echo" }, "opts") end)
+    end)
+
+
+    nix_it("should error on bad options", function()
+      assert.has_error(function() system.spawn({ "true" }, { env = "A=B" }) end)
+      assert.has_error(function() system.spawn({ "true" }, { stdout = true }) end)
+      assert.has_error(function() system.spawn({ "true" }, { stderr = {} }) end)
+    end)
+
+
+    nix_it("should error on a closed file handle", function()
+      local f = assert(io.open(tmpfile, "wb"))
+      f:close()
+      assert.has_error(function() system.spawn({ "true" }, { stdout = f }) end,
+        "bad option 'stdout', expected a file, path, fd, or false")
+    end)
+
+  end)
+
+
+
+  describe("waitpid()", function()
+
+    nix_it("should report 'running' with nohang", function()
+      local pid = assert(system.spawn({ "sleep", "1" }))
+      assert.are.equal("running", system.waitpid(pid, true))
+      assert.are.same({ "exit", 0 }, { system.waitpid(pid) })
+    end)
+
+
+    nix_it("should report a signal", function()
+      local pid = assert(system.spawn({ "sh", "-c", "kill -9 $$" }))
+      assert.are.same({ "signal", 9 }, { system.waitpid(pid) })
+    end)
+
+
+    nix_it("should return an error for an unknown process", function()
+      local pid = assert(system.spawn({ "true" }))
+      system.waitpid(pid)
+      local ok, err = system.waitpid(pid)
+      assert.is_nil(ok)
+      assert.is_string(err)
+    end)
+
+
+    it("should error on bad arguments", function()
+      assert.has_error(function() system.waitpid() end)
+      assert.has_error(function() system.waitpid(0) end)
+    end)
+
+  end)
+
+end)
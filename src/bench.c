@@ -0,0 +1,170 @@
+/// @module system
+
+/// Benchmarking.
+// @section bench
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <stdlib.h>
+#include <math.h>
+#include "compat.h"
+#include "systime.h"
+
+
+// reads an optional numeric field from the options table
+static lua_Number bench_optfield(lua_State *L, int index, const char *name, lua_Number def) {
+    lua_Number value = def;
+    if (lua_isnoneornil(L, index)) return def;
+    lua_getfield(L, index, name);
+    if (!lua_isnil(L, -1)) {
+        if (!lua_isnumber(L, -1)) {
+            luaL_error(L, "bad option '%s', expected a number", name);
+        }
+        value = lua_tonumber(L, -1);
+    }
+    lua_pop(L, 1);
+    return value;
+}
+
+static int bench_cmp(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// calls the function at index 1, 'n' times, returns the elapsed time in ns
+static int64_t bench_run(lua_State *L, int64_t n) {
+    int64_t start = time_monotime_ns();
+    for (int64_t i = 0; i < n; i++) {
+        lua_pushvalue(L, 1);
+        lua_call(L, 0, 0);
+    }
+    return time_monotime_ns() - start;
+}
+
+// sets a numeric field in the table on top of the stack
+static void bench_setfield(lua_State *L, const char *name, double value) {
+    lua_pushnumber(L, value);
+    lua_setfield(L, -2, name);
+}
+
+// sets an integer field in the table on top of the stack
+static void bench_setintfield(lua_State *L, const char *name, int64_t value) {
+    ls_pushint64(L, value);
+    lua_setfield(L, -2, name);
+}
+
+// returns the sample at percentile 'p' (nearest rank), from sorted samples
+static double bench_percentile(const double *samples, int count, double p) {
+    int rank = (int)(p / 100.0 * count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return samples[rank - 1];
+}
+
+
+
+/***
+Benchmarks a function.
+The function is called repeatedly, and timed on the monotonic clock, from C. So the
+measurement only includes the overhead of a Lua function call.
+
+First the function runs for the warmup time, which is also used to estimate its duration. Then
+`samples` batches are timed. Unless `iterations` is given, the batch size is calculated such that
+all samples take `time` seconds in total. A full garbage collection runs before the measurements.
+
+All results are in nanoseconds per call.
+@function bench
+@tparam function fn the function to benchmark, it is called without arguments.
+@tparam[opt] table opts options table with the following (optional) fields:
+@tparam[opt=0.1] number opts.warmup the warmup time in seconds.
+@tparam[opt=1] number opts.time the approximate time in seconds to run the measurements.
+@tparam[opt=100] integer opts.samples the number of samples (batches) to take.
+@tparam[opt] integer opts.iterations the number of calls per sample, calculated if omitted.
+@treturn table the results, with fields `samples`, `iterations` (per sample),
+`total` (number of calls measured), `mean`, `min`, `max`, `stddev`, `p50`, `p90`, `p99`.
+@usage
+local system = require('system')
+local result = system.bench(function() system.gettime() end)
+print(("gettime: %.1f ns (p99 %.1f ns)"):format(result.p50, result.p99))
+*/
+static int bench_lua_bench(lua_State *L) {
+    luaL_checktype(L, 1, LUA_TFUNCTION);
+    if (!lua_isnoneornil(L, 2)) luaL_checktype(L, 2, LUA_TTABLE);
+
+    lua_Number warmup = bench_optfield(L, 2, "warmup", 0.1);
+    lua_Number duration = bench_optfield(L, 2, "time", 1.0);
+    lua_Number samples_opt = bench_optfield(L, 2, "samples", 100);
+    lua_Number iterations_opt = bench_optfield(L, 2, "iterations", 0);
+    luaL_argcheck(L, warmup >= 0.0, 2, "warmup must not be negative");
+    luaL_argcheck(L, duration > 0.0, 2, "time must be greater than 0");
+    luaL_argcheck(L, samples_opt >= 1 && samples_opt <= 1000000, 2, "samples must be between 1 and 1000000");
+    luaL_argcheck(L, iterations_opt >= 0, 2, "iterations must not be negative");
+    int sample_count = (int)samples_opt;
+    int64_t iterations = (int64_t)iterations_opt;
+
+    // allocate as userdata, so it gets collected if the function errors; it must stay
+    // on the stack (index 3), the collection below would free it otherwise
+    lua_settop(L, 2);  // fn, opts
+    double *samples = (double *)lua_newuserdata(L, sizeof(double) * sample_count);
+
+    // warmup, and estimate the duration of a call
+    int64_t warmup_ns = (int64_t)(warmup * 1.0e9);
+    int64_t calls = 0;
+    int64_t elapsed = 0;
+    int64_t batch = 1;
+    do {
+        elapsed += bench_run(L, batch);
+        calls += batch;
+        if (batch < 1024) batch *= 2;
+    } while (elapsed < warmup_ns);
+
+    if (iterations == 0) {
+        double call_ns = (double)elapsed / calls;
+        if (call_ns < 1.0) call_ns = 1.0;
+        iterations = (int64_t)(duration * 1.0e9 / sample_count / call_ns);
+        if (iterations < 1) iterations = 1;
+    }
+
+    lua_gc(L, LUA_GCCOLLECT, 0);
+
+    double sum = 0.0;
+    for (int i = 0; i < sample_count; i++) {
+        samples[i] = (double)bench_run(L, iterations) / iterations;
+        sum += samples[i];
+    }
+
+    double mean = sum / sample_count;
+    double variance = 0.0;
+    for (int i = 0; i < sample_count; i++) {
+        variance += (samples[i] - mean) * (samples[i] - mean);
+    }
+    qsort(samples, sample_count, sizeof(double), bench_cmp);
+
+    lua_newtable(L);
+    bench_setintfield(L, "samples", sample_count);
+    bench_setintfield(L, "iterations", iterations);
+    bench_setintfield(L, "total", iterations * sample_count);
+    bench_setfield(L, "mean", mean);
+    bench_setfield(L, "min", samples[0]);
+    bench_setfield(L, "max", samples[sample_count - 1]);
+    bench_setfield(L, "stddev", sample_count > 1 ? sqrt(variance / (sample_count - 1)) : 0.0);
+    bench_setfield(L, "p50", bench_percentile(samples, sample_count, 50));
+    bench_setfield(L, "p90", bench_percentile(samples, sample_count, 90));
+    bench_setfield(L, "p99", bench_percentile(samples, sample_count, 99));
+    return 1;
+}
+
+
+
+static luaL_Reg func[] = {
+    { "bench", bench_lua_bench },
+    { NULL, NULL }
+};
+
+/*-------------------------------------------------------------------------
+ * Initializes module
+ *-------------------------------------------------------------------------*/
+void bench_open(lua_State *L) {
+    luaL_setfuncs(L, func, 0);
+}
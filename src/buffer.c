@@ -0,0 +1,221 @@
+/// Byte buffer module.
+// The buffer object is a fixed size, mutable block of bytes. It can be refilled
+// in place, for example with random data, without creating a new Lua string (and
+// garbage) every time.
+//
+// Indices follow `string.sub`: they start at 1, and negative indices count from the end.
+//
+// See `system.buffer` (the constructor) for an example.
+// @classmod buffer
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <string.h>
+#include "compat.h"
+#include "sysrandom.h"
+
+#define BUFFER_MT_NAME "LuaSystem.Buffer"
+
+typedef struct {
+    size_t size;
+    unsigned char data[1];  // allocated with the object
+} LS_Buffer;
+
+
+static LS_Buffer *lsbuf_check(lua_State *L, int index) {
+    return (LS_Buffer *)luaL_checkudata(L, index, BUFFER_MT_NAME);
+}
+
+static LS_Buffer *lsbuf_push(lua_State *L, size_t size) {
+    LS_Buffer *b = (LS_Buffer *)lua_newuserdata(L, sizeof(LS_Buffer) + size);
+    b->size = size;
+    luaL_getmetatable(L, BUFFER_MT_NAME);
+    lua_setmetatable(L, -2);
+    return b;
+}
+
+// Gets the range [i, j] from the arguments at 'index' and 'index + 1' (defaults
+// 1 and -1), like string.sub. Returns the 0-based start, and the length in 'len'.
+static size_t lsbuf_range(lua_State *L, LS_Buffer *b, int index, size_t *len) {
+    lua_Integer size = (lua_Integer)b->size;
+    lua_Integer i = luaL_optinteger(L, index, 1);
+    lua_Integer j = luaL_optinteger(L, index + 1, -1);
+    if (i < 0) i = i < -size ? 1 : size + i + 1;
+    if (j < 0) j = size + j + 1;
+    if (i < 1) i = 1;
+    if (j > size) j = size;
+    *len = i > j ? 0 : (size_t)(j - i + 1);
+    return i > j ? 0 : (size_t)(i - 1);
+}
+
+
+
+/***
+Creates a new buffer.
+@function system.buffer
+@tparam int|string size the size in bytes (the contents are zeroed), or a string to copy
+@treturn buffer the new buffer
+@usage
+local sys = require 'system'
+local buf = sys.buffer(4 * 1024 * 1024)
+
+for i = 1, 1000 do
+  assert(buf:fillrandom())  -- new random data, no allocation
+  fuzz(buf:tostring())
+end
+*/
+static int lsbuf_new(lua_State *L) {
+    if (lua_type(L, 1) == LUA_TSTRING) {
+        size_t size;
+        const char *s = lua_tolstring(L, 1, &size);
+        LS_Buffer *b = lsbuf_push(L, size);
+        memcpy(b->data, s, size);
+        return 1;
+    }
+
+    lua_Integer size = luaL_checkinteger(L, 1);
+    luaL_argcheck(L, size >= 0, 1, "size must not be negative");
+    LS_Buffer *b = lsbuf_push(L, (size_t)size);
+    memset(b->data, 0, (size_t)size);
+    return 1;
+}
+
+/***
+Returns the size of the buffer.
+The length operator `#buf` also works.
+@function buffer:len
+@treturn int the size in bytes
+*/
+static int lsbuf_lua_len(lua_State *L) {
+    lua_pushinteger(L, (lua_Integer)lsbuf_check(L, 1)->size);
+    return 1;
+}
+
+/***
+Fills (a part of) the buffer with random bytes, in place.
+The bytes come from the same OS source as `system.random`.
+@function buffer:fillrandom
+@tparam[opt=1] int offset the position of the first byte to fill
+@tparam[opt] int len the number of bytes to fill, defaults to the rest of the buffer
+@treturn[1] buffer the buffer itself
+@treturn[2] nil
+@treturn[2] string error message
+*/
+static int lsbuf_lua_fillrandom(lua_State *L) {
+    LS_Buffer *b = lsbuf_check(L, 1);
+    lua_Integer offset = luaL_optinteger(L, 2, 1);
+    luaL_argcheck(L, offset >= 1 && (size_t)offset <= b->size + 1, 2, "offset out of range");
+    lua_Integer len = luaL_optinteger(L, 3, (lua_Integer)(b->size - offset + 1));
+    luaL_argcheck(L, len >= 0 && (size_t)len <= b->size - offset + 1, 3, "length out of range");
+
+    if (len > 0 && !random_os_bytes(L, b->data + offset - 1, (size_t)len)) {
+        return 2;
+    }
+    lua_settop(L, 1);
+    return 1;
+}
+
+/***
+Returns (a part of) the contents as a string.
+@function buffer:tostring
+@tparam[opt=1] int i the first byte, like `string.sub`
+@tparam[opt=-1] int j the last byte, like `string.sub`
+@treturn string the bytes
+*/
+static int lsbuf_lua_tostring(lua_State *L) {
+    LS_Buffer *b = lsbuf_check(L, 1);
+    size_t len;
+    size_t start = lsbuf_range(L, b, 2, &len);
+    lua_pushlstring(L, (const char *)b->data + start, len);
+    return 1;
+}
+
+/***
+Returns a new buffer with a copy of a part of this one.
+@function buffer:sub
+@tparam[opt=1] int i the first byte, like `string.sub`
+@tparam[opt=-1] int j the last byte, like `string.sub`
+@treturn buffer the new buffer
+*/
+static int lsbuf_lua_sub(lua_State *L) {
+    LS_Buffer *b = lsbuf_check(L, 1);
+    size_t len;
+    size_t start = lsbuf_range(L, b, 2, &len);
+    LS_Buffer *copy = lsbuf_push(L, len);
+    memcpy(copy->data, b->data + start, len);
+    return 1;
+}
+
+/***
+Returns the values of bytes, like `string.byte`.
+@function buffer:byte
+@tparam[opt=1] int i the first byte
+@tparam[opt=i] int j the last byte
+@treturn int,... the byte values
+*/
+static int lsbuf_lua_byte(lua_State *L) {
+    LS_Buffer *b = lsbuf_check(L, 1);
+    lua_Integer i = luaL_optinteger(L, 2, 1);
+    if (lua_isnoneornil(L, 3)) {
+        lua_settop(L, 2);
+        lua_pushinteger(L, i);
+    }
+    size_t len;
+    size_t start = lsbuf_range(L, b, 2, &len);
+    luaL_checkstack(L, (int)len, "too many results");
+    for (size_t k = 0; k < len; k++) {
+        lua_pushinteger(L, b->data[start + k]);
+    }
+    return (int)len;
+}
+
+/***
+Writes a string into the buffer.
+@function buffer:write
+@tparam string s the bytes to write
+@tparam[opt=1] int offset the position to write the first byte
+@treturn buffer the buffer itself
+*/
+static int lsbuf_lua_write(lua_State *L) {
+    LS_Buffer *b = lsbuf_check(L, 1);
+    size_t len;
+    const char *s = luaL_checklstring(L, 2, &len);
+    lua_Integer offset = luaL_optinteger(L, 3, 1);
+    luaL_argcheck(L, offset >= 1 && (size_t)offset <= b->size + 1 && len <= b->size - offset + 1,
+                  3, "out of range");
+    memcpy(b->data + offset - 1, s, len);
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int lsbuf_tostring(lua_State *L) {
+    lua_pushfstring(L, "buffer: %d bytes", (int)lsbuf_check(L, 1)->size);
+    return 1;
+}
+
+static const struct luaL_Reg lsbuf_funcs[] = {
+    {"buffer", lsbuf_new},
+    {NULL, NULL}
+};
+
+static const struct luaL_Reg lsbuf_methods[] = {
+    {"len", lsbuf_lua_len},
+    {"fillrandom", lsbuf_lua_fillrandom},
+    {"tostring", lsbuf_lua_tostring},
+    {"sub", lsbuf_lua_sub},
+    {"byte", lsbuf_lua_byte},
+    {"write", lsbuf_lua_write},
+    {"__len", lsbuf_lua_len},
+    {"__tostring", lsbuf_tostring},
+    {NULL, NULL}
+};
+
+void buffer_open(lua_State *L) {
+    luaL_newmetatable(L, BUFFER_MT_NAME);
+    luaL_setfuncs(L, lsbuf_methods, 0);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
+    luaL_setfuncs(L, lsbuf_funcs, 0);
+}
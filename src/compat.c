@@ -1,5 +1,8 @@
 #include <lua.h>
 #include <lauxlib.h>
+#include <lualib.h>
+#include <stdint.h>
+#include "compat.h"
 
 #if LUA_VERSION_NUM == 501 && !defined(LUAJIT_VERSION)
 void luaL_setfuncs(lua_State *L, const luaL_Reg *l, int nup) {
@@ -31,3 +34,49 @@ void *luaL_testudata(lua_State *L, int ud, const char *tname) {
 }
 
 #endif
+
+
+
+void ls_pushint64(lua_State *L, int64_t value) {
+#if LUA_VERSION_NUM >= 503
+    lua_pushinteger(L, (lua_Integer)value);
+#else
+    lua_pushnumber(L, (lua_Number)value);
+#endif
+}
+
+
+
+FILE *ls_tofile(lua_State *L, int idx) {
+#if LUA_VERSION_NUM == 501
+    // a closed file has its FILE* set to NULL
+    FILE **fh = (FILE **)luaL_testudata(L, idx, LUA_FILEHANDLE);
+    return fh == NULL ? NULL : *fh;
+#else
+    // a closed file has 'closef' set to NULL, 'f' is left dangling (see liolib.c)
+    luaL_Stream *p = (luaL_Stream *)luaL_testudata(L, idx, LUA_FILEHANDLE);
+    return (p == NULL || p->closef == NULL) ? NULL : p->f;
+#endif
+}
+
+
+
+#if LUA_VERSION_NUM == 501
+char *ls_buffinitsize(lua_State *L, luaL_Buffer *B, size_t size) {
+    luaL_buffinit(L, B);
+    if (size <= LUAL_BUFFERSIZE) {
+        return luaL_prepbuffer(B);
+    }
+    return (char *)lua_newuserdata(L, size);
+}
+
+void ls_pushresultsize(luaL_Buffer *B, size_t size) {
+    if (size <= LUAL_BUFFERSIZE) {
+        luaL_addsize(B, size);
+        luaL_pushresult(B);
+    } else {
+        lua_pushlstring(B->L, (const char *)lua_touserdata(B->L, -1), size);
+        lua_remove(B->L, -2);
+    }
+}
+#endif
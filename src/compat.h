@@ -3,12 +3,45 @@
 
 #include <lua.h>
 #include <lauxlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#if LUA_VERSION_NUM == 501
+#define lua_rawlen lua_objlen
+#endif
 
 #if LUA_VERSION_NUM == 501 && !defined(LUAJIT_VERSION)
 void luaL_setfuncs(lua_State *L, const luaL_Reg *l, int nup);
 void *luaL_testudata(lua_State *L, int ud, const char *tname);
 #endif
 
+// Pushes a 64-bit integer. Lua versions without 64-bit integers (< 5.3) get
+// a float, which loses precision beyond 2^53.
+void ls_pushint64(lua_State *L, int64_t value);
+
+// Returns the FILE of the Lua file handle at 'idx', or NULL if the value is
+// not a file handle, or if the file was already closed.
+FILE *ls_tofile(lua_State *L, int idx);
+
+// Prepares a buffer for a result string of exactly 'size' bytes, and
+// ls_pushresultsize pushes it (with the same 'size'). On Lua 5.1 (and LuaJIT)
+// large sizes fall back to a userdata that is copied into the string.
+#if LUA_VERSION_NUM == 501
+char *ls_buffinitsize(lua_State *L, luaL_Buffer *B, size_t size);
+void ls_pushresultsize(luaL_Buffer *B, size_t size);
+#else
+#define ls_buffinitsize luaL_buffinitsize
+#define ls_pushresultsize luaL_pushresultsize
+#endif
+
+
+// Thread local storage, for caches and state that must not be shared between threads.
+#ifdef _MSC_VER
+#define LS_THREAD_LOCAL __declspec(thread)
+#else
+#define LS_THREAD_LOCAL __thread
+#endif
+
 
 #ifdef __MINGW32__
 #include <sys/types.h>
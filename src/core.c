@@ -17,6 +17,11 @@ void environment_open(lua_State *L);
 void random_open(lua_State *L);
 void term_open(lua_State *L);
 void bitflags_open(lua_State *L);
+void histogram_open(lua_State *L);
+void bench_open(lua_State *L);
+void rng_open(lua_State *L);
+void buffer_open(lua_State *L);
+void process_open(lua_State *L);
 
 /*-------------------------------------------------------------------------
  * Initializes all library modules.
@@ -38,8 +43,13 @@ LUAEXPORT int luaopen_system_core(lua_State *L) {
     lua_rawset(L, -3);
     bitflags_open(L); // must be first, used by others
     time_open(L);
+    histogram_open(L);
+    bench_open(L);
     random_open(L);
+    rng_open(L);
+    buffer_open(L);
     term_open(L);
     environment_open(L);
+    process_open(L);
     return 1;
 }
@@ -6,25 +6,236 @@
 #include <lua.h>
 #include <lauxlib.h>
 #include "compat.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "sysenv.h"
+
 #ifdef _WIN32
 #include "windows.h"
+#define env_atomic_inc(p) InterlockedIncrement(p)
+#define env_atomic_dec(p) InterlockedDecrement(p)
+#define env_atomic_swap(p, v) InterlockedExchange((p), (v))
+#define env_atomic_load(p) InterlockedCompareExchange((p), 0, 0)
+#define env_atomic_loadptr(p) InterlockedCompareExchangePointer((PVOID volatile *)(p), NULL, NULL)
+#define env_atomic_swapptr(p, v) InterlockedExchangePointer((PVOID volatile *)(p), (v))
+#define env_yield() SwitchToThread()
+#else
+#include <sched.h>
+#define env_atomic_inc(p) __atomic_add_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define env_atomic_dec(p) __atomic_sub_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define env_atomic_swap(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define env_atomic_load(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define env_atomic_loadptr(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define env_atomic_swapptr(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define env_yield() sched_yield()
 #endif
 
-/***
-Gets the value of an environment variable.
 
-__NOTE__: Windows has multiple copies of environment variables. For this reason,
-the `setenv` function will not work with Lua's `os.getenv` on Windows. If you want
-to use `setenv` then consider patching `os.getenv` with this implementation of `getenv`.
-@function getenv
-@tparam string name name of the environment variable
-@treturn string|nil value of the environment variable, or nil if the variable is not set
-*/
-static int lua_get_environment_variable(lua_State* L) {
-    const char* variableName = luaL_checkstring(L, 1);
+// Incremented by setenv (in any thread), so cached copies of the environment know
+// when they are stale.
+static volatile long env_generation = 1;
+
+
+// The shared environment: if enabled (see `sharedenv`), the current snapshot. Readers
+// take a reference without locking; setenv replaces it with a new one.
+static LS_EnvSnapshot *volatile env_shared = NULL;
+static volatile long env_acquiring = 0;  // readers between loading 'env_shared' and taking a reference
+static volatile long env_writer = 0;     // spinlock, serializes writers
+
+
+static void env_lock(void) {
+    while (env_atomic_swap(&env_writer, 1) != 0) {
+        env_yield();
+    }
+}
+
+static void env_unlock(void) {
+    env_atomic_swap(&env_writer, 0);
+}
+
+LS_EnvSnapshot *env_snapshot_acquire(void) {
+    env_atomic_inc(&env_acquiring);
+    LS_EnvSnapshot *snapshot = (LS_EnvSnapshot *)env_atomic_loadptr(&env_shared);
+    if (snapshot != NULL) {
+        env_atomic_inc(&snapshot->refs);
+    }
+    env_atomic_dec(&env_acquiring);
+    return snapshot;
+}
+
+void env_snapshot_release(LS_EnvSnapshot *snapshot) {
+    if (env_atomic_dec(&snapshot->refs) == 0) {
+        free(snapshot);
+    }
+}
+
+static int env_name_equal(const char *a, const char *b, size_t len) {
+#ifdef _WIN32
+    return _strnicmp(a, b, len) == 0;
+#else
+    return memcmp(a, b, len) == 0;
+#endif
+}
+
+// Returns the value of a variable in the snapshot, or NULL if it is not set.
+static const char *env_snapshot_get(LS_EnvSnapshot *snapshot, const char *name) {
+    size_t len = strlen(name);
+    for (char **entry = snapshot->entries; *entry != NULL; entry++) {
+        if (env_name_equal(*entry, name, len) && (*entry)[len] == '=') {
+            return *entry + len + 1;
+        }
+    }
+    return NULL;
+}
+
+
+
+// Walks the "name=value" entries of the environment, or of a snapshot of it.
+typedef struct {
+    LS_EnvSnapshot *snapshot;   // NULL if walking the environment itself
+    size_t index;               // an index, since setenv may move 'environ'
+#ifdef _WIN32
+    char *block;                // from GetEnvironmentStrings
+    char *current;
+#endif
+} LS_EnvIter;
+
+// Starts walking the environment itself. Returns 0 if it is not available.
+static int env_iter_start_os(LS_EnvIter *it) {
+    it->snapshot = NULL;
+    it->index = 0;
+#ifdef _WIN32
+    it->block = GetEnvironmentStrings();
+    it->current = it->block;
+    return it->block != NULL;
+#else
+    return 1;
+#endif
+}
+
+// Starts walking the environment, or the shared snapshot if enabled. Returns 0 if
+// it is not available.
+static int env_iter_start(LS_EnvIter *it) {
+    it->snapshot = env_snapshot_acquire();
+    if (it->snapshot == NULL) {
+        return env_iter_start_os(it);
+    }
+    it->index = 0;
+#ifdef _WIN32
+    it->block = NULL;
+#endif
+    return 1;
+}
+
+// Returns the next entry, or NULL at the end.
+static const char *env_iter_next(LS_EnvIter *it) {
+    if (it->snapshot != NULL) {
+        const char *entry = it->snapshot->entries[it->index];
+        if (entry != NULL) it->index++;
+        return entry;
+    }
+#ifdef _WIN32
+    if (it->block == NULL || *it->current == '\0') return NULL;
+    const char *entry = it->current;
+    it->current += strlen(it->current) + 1;
+    return entry;
+#else
+    extern char** environ;
+    if (environ == NULL || environ[it->index] == NULL) return NULL;
+    return environ[it->index++];
+#endif
+}
+
+// Restarts the walk, from the first entry.
+static void env_iter_rewind(LS_EnvIter *it) {
+    it->index = 0;
+#ifdef _WIN32
+    it->current = it->block;
+#endif
+}
+
+static void env_iter_end(LS_EnvIter *it) {
+    if (it->snapshot != NULL) {
+        env_snapshot_release(it->snapshot);
+        it->snapshot = NULL;
+    }
+#ifdef _WIN32
+    if (it->block != NULL) {
+        FreeEnvironmentStrings(it->block);
+        it->block = NULL;
+    }
+#endif
+}
+
+// Copies the environment into a new snapshot (a single allocation). Returns NULL if
+// the environment is not available, or out of memory.
+static LS_EnvSnapshot *env_snapshot_new(void) {
+    LS_EnvIter it;
+    if (!env_iter_start_os(&it)) {
+        return NULL;
+    }
+    size_t count = 0;
+    size_t size = 0;
+    const char *entry;
+    while ((entry = env_iter_next(&it)) != NULL) {
+        size += strlen(entry) + 1;
+        count++;
+    }
+
+    LS_EnvSnapshot *snapshot = (LS_EnvSnapshot *)malloc(sizeof(LS_EnvSnapshot) + count * sizeof(char *) + size);
+    if (snapshot != NULL) {
+        snapshot->refs = 1;  // the reference of 'env_shared'
+        char *data = (char *)&snapshot->entries[count + 1];
+        size_t i = 0;
+        env_iter_rewind(&it);
+        while ((entry = env_iter_next(&it)) != NULL && i < count) {
+            size_t len = strlen(entry) + 1;
+            memcpy(data, entry, len);
+            snapshot->entries[i++] = data;
+            data += len;
+        }
+        snapshot->entries[i] = NULL;
+    }
+    env_iter_end(&it);
+    return snapshot;
+}
+
+// Replaces the shared snapshot with a new copy of the environment, must be called with
+// the writer lock held. Returns 0 if out of memory, the old snapshot then remains.
+static int env_snapshot_update(void) {
+    LS_EnvSnapshot *snapshot = env_snapshot_new();
+    if (snapshot == NULL) {
+        return 0;
+    }
+    LS_EnvSnapshot *old = (LS_EnvSnapshot *)env_atomic_swapptr(&env_shared, snapshot);
+    // readers that loaded the old pointer have taken their reference once this drops to 0
+    while (env_atomic_load(&env_acquiring) != 0) {
+        env_yield();
+    }
+    if (old != NULL) {
+        env_snapshot_release(old);
+    }
+    return 1;
+}
+
+
+
+// Pushes the value of an environment variable, and returns 1. Returns 0 (and pushes
+// nothing) if the variable is not set, or an error occurs.
+static int env_pushvalue(lua_State *L, const char *variableName) {
+    LS_EnvSnapshot *snapshot = env_snapshot_acquire();
+    if (snapshot != NULL) {
+        // a memory error while pushing would leak the reference (and the snapshot)
+        const char *variableValue = env_snapshot_get(snapshot, variableName);
+        int found = variableValue != NULL;
+        if (found) {
+            lua_pushstring(L, variableValue);
+        }
+        env_snapshot_release(snapshot);
+        return found;
+    }
 
 #ifdef _WIN32
     // On Windows, use GetEnvironmentVariable to retrieve the value
@@ -46,67 +257,565 @@ static int lua_get_environment_variable(lua_State* L) {
         return 1;
     }
 #endif
+    return 0;
+}
 
-    // If the variable is not set or an error occurs, push nil
-    lua_pushnil(L);
+
+
+/***
+Gets the value of an environment variable.
+
+__NOTE__: Windows has multiple copies of environment variables. For this reason,
+the `setenv` function will not work with Lua's `os.getenv` on Windows. If you want
+to use `setenv` then consider patching `os.getenv` with this implementation of `getenv`.
+@function getenv
+@tparam string name name of the environment variable
+@treturn string|nil value of the environment variable, or nil if the variable is not set
+*/
+static int lua_get_environment_variable(lua_State* L) {
+    const char* variableName = luaL_checkstring(L, 1);
+
+    if (!env_pushvalue(L, variableName)) {
+        // If the variable is not set or an error occurs, push nil
+        lua_pushnil(L);
+    }
     return 1;
 }
 
 
+
+// checks if a variable exists
+static int env_exists(const char *name) {
+    LS_EnvSnapshot *snapshot = env_snapshot_acquire();
+    if (snapshot != NULL) {
+        int exists = env_snapshot_get(snapshot, name) != NULL;
+        env_snapshot_release(snapshot);
+        return exists;
+    }
+#ifdef _WIN32
+    return GetEnvironmentVariable(name, NULL, 0) > 0 || GetLastError() != ERROR_ENVVAR_NOT_FOUND;
+#else
+    return getenv(name) != NULL;
+#endif
+}
+
+// Returns the '=' of the entry, or NULL if it has none, or the name does not start
+// with 'prefix' (case insensitive on Windows, like the names). A NULL prefix matches all.
+static const char *env_match(const char *entry, const char *prefix, size_t prefix_len) {
+    if (prefix != NULL) {
+#ifdef _WIN32
+        if (_strnicmp(entry, prefix, prefix_len) != 0) return NULL;
+#else
+        if (strncmp(entry, prefix, prefix_len) != 0) return NULL;
+#endif
+    }
+    const char *equals = strchr(entry, '=');
+    if (equals == NULL || (size_t)(equals - entry) < prefix_len) return NULL;
+    return equals;
+}
+
+// Updates the table at 'index' to match the environment, or the variables starting
+// with 'prefix' if not NULL. Only changed values are pushed, and only if the table
+// has more entries than the environment, it is checked for removed variables.
+// Returns -1 if the environment is not available, or else whether the table was changed.
+static int env_sync(lua_State *L, int index, const char *prefix, size_t prefix_len) {
+    LS_EnvIter it;
+    int changed = 0;
+    lua_Integer count = 0;
+
+    if (!env_iter_start(&it)) {
+        return -1;
+    }
+    const char *entry;
+    while ((entry = env_iter_next(&it)) != NULL) {
+        const char *equals = env_match(entry, prefix, prefix_len);
+        if (equals == NULL) continue;
+
+        const char *value = equals + 1;
+        size_t value_len = strlen(value);
+        lua_pushlstring(L, entry, equals - entry);  // the key
+        lua_pushvalue(L, -1);
+        lua_rawget(L, index);
+        size_t old_len;
+        const char *old = lua_type(L, -1) == LUA_TSTRING ? lua_tolstring(L, -1, &old_len) : NULL;
+        if (old != NULL && old_len == value_len && memcmp(old, value, value_len) == 0) {
+            lua_pop(L, 2);
+        } else {
+            lua_pop(L, 1);
+            lua_pushlstring(L, value, value_len);
+            lua_rawset(L, index);
+            changed = 1;
+        }
+        count++;
+    }
+    env_iter_end(&it);
+
+    lua_Integer table_count = 0;
+    lua_pushnil(L);
+    while (lua_next(L, index) != 0) {
+        table_count++;
+        lua_pop(L, 1);
+    }
+    if (table_count == count) {
+        return changed;
+    }
+
+    // remove the variables that no longer exist
+    lua_pushnil(L);
+    while (lua_next(L, index) != 0) {
+        lua_pop(L, 1);
+        if (lua_type(L, -1) != LUA_TSTRING || !env_exists(lua_tostring(L, -1))) {
+            lua_pushvalue(L, -1);
+            lua_pushnil(L);
+            lua_rawset(L, index);  // clearing a field during traversal is allowed
+            changed = 1;
+        }
+    }
+    return changed;
+}
+
+
+
 /***
 Returns a table with all environment variables.
+Without a table, a new table is returned on every call. With a prefix, only the variables
+whose names start with it are included (filtered in C).
+
+A table passed in is updated in place, which is much cheaper than building a new one;
+only changed values are set, and removed variables are cleared. The table is remembered
+(weakly), and if `setenv` has not been called since the last update, it is returned
+as is, without looking at the environment at all.
+
+__NOTE__: only changes made with `setenv` are tracked. If the environment is changed
+in another way (eg. by C code), use `force` to update the table anyway.
 @function getenvs
+@tparam[opt] table|string tbl a table to update, instead of creating a new one, or a prefix
+(on Windows case insensitive) to return a new table with only the matching variables
+@tparam[opt=false] boolean force update `tbl` even if `setenv` was not called since the last update
 @treturn table table with all environment variables and their values
+@treturn[opt] boolean if `tbl` was given; `true` if it was changed
+@usage
+local sys = require 'system'
+local env = {}
+
+local function reload()
+  local _, changed = sys.getenvs(env)
+  if changed then
+    -- reconfigure
+  end
+end
+
+local otel = sys.getenvs("OTEL_")
 */
 static int lua_list_environment_variables(lua_State* L) {
-    lua_newtable(L);
+    if (lua_isnoneornil(L, 1) || lua_type(L, 1) == LUA_TSTRING) {
+        size_t prefix_len = 0;
+        const char *prefix = luaL_optlstring(L, 1, NULL, &prefix_len);
+        lua_newtable(L);
+        if (env_sync(L, lua_gettop(L), prefix, prefix_len) < 0) {
+            lua_pushnil(L);
+        }
+        return 1;
+    }
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+    int force = lua_toboolean(L, 2);
+    lua_settop(L, 1);
+
+    // the upvalue is a weak table, tbl -> generation of the last update
+    lua_pushvalue(L, 1);
+    lua_rawget(L, lua_upvalueindex(1));
+    lua_Number generation = (lua_Number)env_atomic_load(&env_generation);
+    if (!force && lua_tonumber(L, -1) == generation) {
+        lua_settop(L, 1);
+        lua_pushboolean(L, 0);
+        return 2;
+    }
+    lua_settop(L, 1);
 
+    int changed = env_sync(L, 1, NULL, 0);
+    if (changed < 0) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_pushvalue(L, 1);
+    lua_pushnumber(L, generation);  // as read before the update, changes since then show next time
+    lua_rawset(L, lua_upvalueindex(1));
+    lua_pushboolean(L, changed);
+    return 2;
+}
+
+
+// a requested name in the getenvmany hash table
+typedef struct {
+    const char *name;   // NULL for an empty slot
+    size_t len;
+    uint32_t hash;
+    const char *value;  // points into the environment, NULL if not found (yet)
+} LS_EnvSlot;
+
+// FNV-1a; case insensitive on Windows, like the names
+static uint32_t env_hash(const char *name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)name[i];
 #ifdef _WIN32
-    char* envStrings = GetEnvironmentStrings();
-    char* envString = envStrings;
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+#endif
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+// Returns the slot for the name; the matching one, or an empty one. 'mask' is size - 1.
+static LS_EnvSlot *env_slot(LS_EnvSlot *slots, size_t mask, const char *name, size_t len, uint32_t hash) {
+    size_t i = hash & mask;
+    while (slots[i].name != NULL) {
+        if (slots[i].hash == hash && slots[i].len == len && env_name_equal(slots[i].name, name, len)) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return &slots[i];
+}
 
-    if (envStrings == NULL) {
+
+
+/***
+Gets the values of multiple environment variables.
+The environment is only walked once, so this is much faster than calling `getenv`
+for each name.
+@function getenvmany
+@tparam table names array of the names of the variables
+@tparam[opt] table out table to store the results in, a new table is created if omitted
+@treturn table table with the names as keys, and the values of the variables. Variables
+that are not set are `nil` (also in `out`, if they were set before).
+@usage
+local sys = require 'system'
+local env = sys.getenvmany { "HOME", "LANG", "APP_PORT" }
+local port = tonumber(env.APP_PORT) or 8080
+*/
+static int lua_get_environment_variables(lua_State* L) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    if (lua_isnoneornil(L, 2)) {
+        lua_settop(L, 1);
+        lua_newtable(L);
+    } else {
+        luaL_checktype(L, 2, LUA_TTABLE);
+        lua_settop(L, 2);
+    }
+
+    int count = (int)lua_rawlen(L, 1);
+    size_t size = 8;
+    while (size < (size_t)count * 2) size *= 2;  // at most half full
+    LS_EnvSlot *slots = (LS_EnvSlot *)lua_newuserdata(L, size * sizeof(LS_EnvSlot));  // index 3
+    memset(slots, 0, size * sizeof(LS_EnvSlot));
+
+    // the names stay referenced by the names table, so the pointers remain valid
+    for (int i = 1; i <= count; i++) {
+        lua_rawgeti(L, 1, i);
+        if (lua_type(L, -1) != LUA_TSTRING) {
+            return luaL_argerror(L, 1, "names must be strings");
+        }
+        size_t len;
+        const char *name = lua_tolstring(L, -1, &len);
+        uint32_t hash = env_hash(name, len);
+        LS_EnvSlot *slot = env_slot(slots, size - 1, name, len, hash);
+        slot->name = name;
+        slot->len = len;
+        slot->hash = hash;
+        lua_pop(L, 1);
+    }
+
+    LS_EnvIter it;
+    if (!env_iter_start(&it)) {
         lua_pushnil(L);
         return 1;
     }
+    const char *entry;
+    while ((entry = env_iter_next(&it)) != NULL) {
+        const char *equals = strchr(entry, '=');
+        if (equals == NULL) continue;
+        size_t len = equals - entry;
+        LS_EnvSlot *slot = env_slot(slots, size - 1, entry, len, env_hash(entry, len));
+        if (slot->name != NULL && slot->value == NULL) {
+            slot->value = equals + 1;  // the first one, like getenv
+        }
+    }
 
-    while (*envString != '\0') {
-        const char* envVar = envString;
+    for (size_t i = 0; i < size; i++) {
+        if (slots[i].name != NULL) {
+            lua_pushlstring(L, slots[i].name, slots[i].len);
+            if (slots[i].value != NULL) {
+                lua_pushstring(L, slots[i].value);
+            } else {
+                lua_pushnil(L);
+            }
+            lua_rawset(L, 2);
+        }
+    }
+    env_iter_end(&it);
 
-        // Split the environment variable into key and value
-        char* equals = strchr(envVar, '=');
-        if (equals != NULL) {
-            lua_pushlstring(L, envVar, equals - envVar); // Push the key
-            lua_pushstring(L, equals + 1); // Push the value
-            lua_settable(L, -3); // Set the key-value pair in the table
+    lua_settop(L, 2);
+    return 1;
+}
+
+
+
+#define EXPAND_MAX_DEPTH 32     // nesting of defaults
+#define EXPAND_NAME_SIZE 256    // names longer than this are copied into a Lua string
+
+static int env_isnamestart(char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+}
+
+static int env_isname(char c) {
+    return env_isnamestart(c) || (c >= '0' && c <= '9');
+}
+
+// Pushes the value of the variable, from the overrides table (if 'overrides' is not 0),
+// or the environment. Returns 0 (and pushes nothing) if it is not set.
+static int env_lookup(lua_State *L, int overrides, const char *name, size_t len) {
+    if (overrides != 0) {
+        lua_pushlstring(L, name, len);
+        lua_gettable(L, overrides);
+        int type = lua_type(L, -1);
+        if (type == LUA_TSTRING || type == LUA_TNUMBER) {
+            return 1;
         }
+        lua_pop(L, 1);
+        if (type == LUA_TBOOLEAN) {
+            return 0;  // false: unset
+        }
+    }
 
-        envString += strlen(envString) + 1;
+    if (len < EXPAND_NAME_SIZE) {
+        char buffer[EXPAND_NAME_SIZE];
+        memcpy(buffer, name, len);
+        buffer[len] = '\0';
+        return env_pushvalue(L, buffer);
     }
+    lua_pushlstring(L, name, len);
+    if (env_pushvalue(L, lua_tostring(L, -1))) {
+        lua_remove(L, -2);
+        return 1;
+    }
+    lua_pop(L, 1);
+    return 0;
+}
 
-    FreeEnvironmentStrings(envStrings);
-#else
-    extern char** environ;
+// Expands 's' into the buffer. Returns NULL, or an error message.
+static const char *env_expand(lua_State *L, luaL_Buffer *b, int overrides, const char *s, size_t len, int depth) {
+    const char *end = s + len;
+
+    if (depth > EXPAND_MAX_DEPTH) {
+        return "defaults nested too deeply";
+    }
+
+    while (s < end) {
+        const char *dollar = (const char *)memchr(s, '$', end - s);
+        if (dollar == NULL) {
+            luaL_addlstring(b, s, end - s);
+            break;
+        }
+        luaL_addlstring(b, s, dollar - s);
+        s = dollar + 1;
+
+        if (s < end && *s == '$') {
+            // escaped: "$$"
+            luaL_addchar(b, '$');
+            s++;
+
+        } else if (s < end && env_isnamestart(*s)) {
+            // $NAME
+            const char *name = s;
+            while (s < end && env_isname(*s)) s++;
+            if (env_lookup(L, overrides, name, s - name)) {
+                luaL_addvalue(b);
+            }
+
+        } else if (s < end && *s == '{') {
+            // ${NAME}, ${NAME:-default}, or ${NAME-default}
+            const char *name = ++s;
+            while (s < end && env_isname(*s)) s++;
+            size_t name_len = s - name;
+            if (name_len == 0 || !env_isnamestart(*name) || s == end) {
+                return s == end ? "unterminated '${'" : "bad variable name in '${'";
+            }
+
+            if (*s == '}') {
+                s++;
+                if (env_lookup(L, overrides, name, name_len)) {
+                    luaL_addvalue(b);
+                }
+                continue;
+            }
+
+            int use_empty = 1;  // ':-' also replaces an empty value
+            if (*s == ':' && s + 1 < end && s[1] == '-') {
+                s += 2;
+            } else if (*s == '-') {
+                use_empty = 0;
+                s++;
+            } else {
+                return "bad substitution, expected '}', ':-' or '-'";
+            }
 
-    if (environ != NULL) {
-        for (char** envVar = environ; *envVar != NULL; envVar++) {
-            const char* envVarStr = *envVar;
+            // find the closing brace of the default, skipping nested "${...}"
+            const char *def = s;
+            int nesting = 0;
+            while (s < end) {
+                if (*s == '$' && s + 1 < end && (s[1] == '$' || s[1] == '{')) {
+                    if (s[1] == '{') nesting++;
+                    s += 2;
+                } else if (*s == '}' && nesting-- == 0) {
+                    break;
+                } else {
+                    s++;
+                }
+            }
+            if (s == end) {
+                return "unterminated '${'";
+            }
+            size_t def_len = s - def;
+            s++;
 
-            // Split the environment variable into key and value
-            char* equals = strchr(envVarStr, '=');
-            if (equals != NULL) {
-                lua_pushlstring(L, envVarStr, equals - envVarStr); // Push the key
-                lua_pushstring(L, equals + 1); // Push the value
-                lua_settable(L, -3); // Set the key-value pair in the table
+            if (env_lookup(L, overrides, name, name_len)) {
+                size_t value_len;
+                lua_tolstring(L, -1, &value_len);
+                if (!use_empty || value_len > 0) {
+                    luaL_addvalue(b);
+                    continue;
+                }
+                lua_pop(L, 1);
             }
+            const char *err = env_expand(L, b, overrides, def, def_len, depth + 1);
+            if (err != NULL) {
+                return err;
+            }
+
+        } else {
+            // a lone '$'
+            luaL_addchar(b, '$');
         }
     }
-#endif
+    return NULL;
+}
+
+
+
+/***
+Expands environment variables in a string.
+The string is expanded in a single pass, in C. Supported are:
+
+- `$NAME` and `${NAME}`: the value of the variable, or an empty string if not set
+- `${NAME:-default}`: the value, or `default` if the variable is not set or empty
+- `${NAME-default}`: the value, or `default` if the variable is not set
+- `$$`: a literal `$`
+
+Names consist of letters, digits and underscores, and do not start with a digit. The
+default can contain variables as well. A `$` not followed by a name or `{` is kept as is.
+
+The values are looked up in the `overrides` table first, then in the environment (like `getenv`).
+@function expandenv
+@tparam string str the string to expand
+@tparam[opt] table overrides table with variables that take precedence over the environment.
+A value `false` makes a variable unset.
+@treturn[1] string the expanded string
+@treturn[2] nil
+@treturn[2] string error message, on a syntax error
+@usage
+local sys = require 'system'
+local url = sys.expandenv("http://${HOST:-localhost}:${PORT:-8080}/$APP_PATH", { PORT = 9000 })
+*/
+static int lua_expand_environment_variables(lua_State* L) {
+    size_t len;
+    const char *s = luaL_checklstring(L, 1, &len);
+    int overrides = 0;
+    if (!lua_isnoneornil(L, 2)) {
+        luaL_checktype(L, 2, LUA_TTABLE);
+        overrides = 2;
+    }
+    lua_settop(L, 2);
+
+    luaL_Buffer b;
+    luaL_buffinit(L, &b);
+    const char *err = env_expand(L, &b, overrides, s, len, 0);
+    if (err != NULL) {
+        lua_pushnil(L);
+        lua_pushstring(L, err);
+        return 2;
+    }
+    luaL_pushresult(&b);
+    return 1;
+}
+
+
+
+#define ENVITER_MT_NAME "LuaSystem.EnvIter"
+
+static int env_iter_gc(lua_State *L) {
+    env_iter_end((LS_EnvIter *)luaL_checkudata(L, 1, ENVITER_MT_NAME));
+    return 0;
+}
+
+// the envpairs iterator; upvalues are the LS_EnvIter, and the prefix (or nil)
+static int env_pairs_next(lua_State *L) {
+    LS_EnvIter *it = (LS_EnvIter *)lua_touserdata(L, lua_upvalueindex(1));
+    size_t prefix_len = 0;
+    const char *prefix = lua_tolstring(L, lua_upvalueindex(2), &prefix_len);
+
+    const char *entry;
+    while ((entry = env_iter_next(it)) != NULL) {
+        const char *equals = env_match(entry, prefix, prefix_len);
+        if (equals != NULL) {
+            lua_pushlstring(L, entry, equals - entry);
+            lua_pushstring(L, equals + 1);
+            return 2;
+        }
+    }
+    env_iter_end(it);
+    return 0;
+}
+
+
 
+/***
+Iterates over the environment variables.
+Unlike `getenvs`, no table is created, only the names and values returned are allocated.
+The order is unspecified.
+
+The environment should not be changed during the iteration (with `setenv`), variables
+may then be skipped or returned twice. With `sharedenv` enabled, the iteration walks the
+copy of the environment as it was when the iteration started.
+@function envpairs
+@tparam[opt] string prefix only return the variables whose names start with the prefix
+(on Windows case insensitive)
+@treturn function iterator function, returning name and value
+@usage
+local sys = require 'system'
+for name, value in sys.envpairs("APP_") do
+  print(name, value)
+end
+*/
+static int lua_environment_pairs(lua_State* L) {
+    if (!lua_isnoneornil(L, 1)) luaL_checkstring(L, 1);
+    lua_settop(L, 1);
+
+    LS_EnvIter *it = (LS_EnvIter *)lua_newuserdata(L, sizeof(LS_EnvIter));
+    memset(it, 0, sizeof(LS_EnvIter));
+    luaL_getmetatable(L, ENVITER_MT_NAME);
+    lua_setmetatable(L, -2);
+    if (!env_iter_start(it)) {
+        return luaL_error(L, "failed to get the environment");
+    }
+    lua_pushvalue(L, 1);
+    lua_pushcclosure(L, env_pairs_next, 2);
     return 1;
 }
 
 
+
 /***
 Sets an environment variable.
 
@@ -122,41 +831,80 @@ Windows, setting an empty string, will also delete the variable)
 static int lua_set_environment_variable(lua_State* L) {
     const char* variableName = luaL_checkstring(L, 1);
     const char* variableValue = luaL_optstring(L, 2, NULL);
+    int ok;
+
+    int shared = env_atomic_loadptr(&env_shared) != NULL;
+    if (shared) {
+        env_lock();
+    }
 
 #ifdef _WIN32
-    // if (variableValue == NULL) {
-    //     // If the value is nil, delete the environment variable
-    //     if (SetEnvironmentVariable(variableName, NULL)) {
-    //         lua_pushboolean(L, 1);
-    //     } else {
-    //         lua_pushboolean(L, 0);
-    //     }
-    // } else {
-        // Set the environment variable with the provided value
-        if (SetEnvironmentVariable(variableName, variableValue)) {
-            lua_pushboolean(L, 1);
-        } else {
-            lua_pushboolean(L, 0);
-        }
-    // }
+    // Set the environment variable with the provided value, or delete it if NULL
+    ok = SetEnvironmentVariable(variableName, variableValue) != 0;
 #else
     if (variableValue == NULL) {
         // If the value is nil, delete the environment variable
-        if (unsetenv(variableName) == 0) {
-            lua_pushboolean(L, 1);
-        } else {
-            lua_pushboolean(L, 0);
-        }
+        ok = unsetenv(variableName) == 0;
     } else {
         // Set the environment variable with the provided value
-        if (setenv(variableName, variableValue, 1) == 0) {
-            lua_pushboolean(L, 1);
-        } else {
-            lua_pushboolean(L, 0);
-        }
+        ok = setenv(variableName, variableValue, 1) == 0;
     }
 #endif
 
+    if (shared) {
+        if (ok) {
+            ok = env_snapshot_update();
+        }
+        env_unlock();
+    }
+
+    env_atomic_inc(&env_generation);
+    lua_pushboolean(L, ok);
+    return 1;
+}
+
+
+
+/***
+Enables the shared environment, for hosts that run Lua states in multiple threads.
+Calling `setenv` in one thread while another thread reads the environment is not safe;
+`setenv` may move the environment in memory while it is being read.
+
+Once enabled, `getenv`, `getenvs`, `getenvmany`, `expandenv`, `envpairs` and `spawn` read
+from a process-wide copy of the environment, which is replaced (not modified) by `setenv`.
+Reading only takes a reference to the current copy, without locking, so readers in many
+threads do not block each other. `setenv` calls are serialized, and update both the real
+environment and the copy.
+
+It applies to the whole process, and cannot be disabled again. Enable it before the
+threads start using `setenv` (calling it again from every thread does no harm).
+
+__NOTE__: only the functions of this module use the copy; other code reading the real
+environment (eg. `os.getenv`) is not protected against concurrent `setenv` calls.
+@function sharedenv
+@tparam[opt] boolean enable `true` to enable the shared environment
+@treturn boolean whether the shared environment is enabled
+@usage
+-- in each worker thread, when creating its Lua state
+local sys = require 'system'
+sys.sharedenv(true)
+*/
+static int lua_shared_environment(lua_State* L) {
+    if (!lua_isnoneornil(L, 1)) {
+        luaL_checktype(L, 1, LUA_TBOOLEAN);
+        int enabled = env_atomic_loadptr(&env_shared) != NULL;
+        if (lua_toboolean(L, 1) && !enabled) {
+            env_lock();
+            if (env_atomic_loadptr(&env_shared) == NULL && !env_snapshot_update()) {
+                env_unlock();
+                return luaL_error(L, "failed to copy the environment");
+            }
+            env_unlock();
+        } else if (!lua_toboolean(L, 1) && enabled) {
+            return luaL_error(L, "the shared environment cannot be disabled");
+        }
+    }
+    lua_pushboolean(L, env_atomic_loadptr(&env_shared) != NULL);
     return 1;
 }
 
@@ -164,8 +912,11 @@ static int lua_set_environment_variable(lua_State* L) {
 
 static luaL_Reg func[] = {
     { "getenv", lua_get_environment_variable },
+    { "getenvmany", lua_get_environment_variables },
+    { "expandenv", lua_expand_environment_variables },
     { "setenv", lua_set_environment_variable },
-    { "getenvs", lua_list_environment_variables },
+    { "envpairs", lua_environment_pairs },
+    { "sharedenv", lua_shared_environment },
     { NULL, NULL }
 };
 
@@ -173,5 +924,19 @@ static luaL_Reg func[] = {
  * Initializes module
  *-------------------------------------------------------------------------*/
 void environment_open(lua_State *L) {
+    luaL_newmetatable(L, ENVITER_MT_NAME);
+    lua_pushcfunction(L, env_iter_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+
     luaL_setfuncs(L, func, 0);
+
+    // getenvs keeps the tables it updated, and their generation, in a weak table
+    lua_newtable(L);
+    lua_newtable(L);
+    lua_pushliteral(L, "k");
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+    lua_pushcclosure(L, lua_list_environment_variables, 1);
+    lua_setfield(L, -2, "getenvs");
 }
@@ -0,0 +1,329 @@
+/// Histogram module.
+// The histogram object records latencies (or any other non-negative integer values),
+// and reports percentiles over them. It is meant for timing hot code paths, where
+// collecting the samples in a Lua table would generate too much garbage.
+//
+// The values are counted in log-linear buckets (like an
+// [HDR histogram](http://hdrhistogram.org/)). Values below `2^precision` are counted
+// exactly, above that a bucket covers a range of values, such that the relative
+// error is at most `2^(1-precision)`. The default precision of 7 bits has an error
+// below 1.6%.
+//
+// Recording a value does not allocate any memory.
+//
+// See `system.histogram` (the constructor) for an example.
+// @classmod histogram
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <string.h>
+#include "compat.h"
+#include "systime.h"
+
+#define HISTOGRAM_MT_NAME "LuaSystem.Histogram"
+
+#define HISTOGRAM_MIN_PRECISION 2
+#define HISTOGRAM_MAX_PRECISION 12
+
+typedef struct {
+    int precision;      // number of bits of precision
+    int bucket_count;   // number of entries in 'counts'
+    int running;        // stopwatch running
+    int64_t started;    // stopwatch start time in ns
+    int64_t count;      // total number of values recorded
+    int64_t min;        // smallest value recorded
+    int64_t max;        // largest value recorded
+    double sum;         // sum of values recorded, for the mean
+    int64_t counts[1];  // bucket counts, allocated with the object
+} LS_Histogram;
+
+
+// returns the number of the most significant bit set
+static int lshist_msb(uint64_t value) {
+    int msb = 0;
+    while (value >>= 1) msb++;
+    return msb;
+}
+
+// returns the bucket index for a value
+static int lshist_index(const LS_Histogram *h, int64_t value) {
+    int64_t half = (int64_t)1 << (h->precision - 1);
+    if (value < 2 * half) return (int)value;
+    int shift = lshist_msb((uint64_t)value) - (h->precision - 1);
+    return (int)(shift * half + (value >> shift));
+}
+
+// returns the highest value that falls in the bucket
+static int64_t lshist_highest(const LS_Histogram *h, int index) {
+    int64_t half = (int64_t)1 << (h->precision - 1);
+    if (index < 2 * half) return index;
+    int shift = (int)(index / half) - 1;
+    int64_t m = index - shift * half;
+    return (int64_t)(((uint64_t)(m + 1) << shift) - 1);
+}
+
+static void lshist_reset(LS_Histogram *h) {
+    memset(h->counts, 0, sizeof(int64_t) * h->bucket_count);
+    h->count = 0;
+    h->min = 0;
+    h->max = 0;
+    h->sum = 0.0;
+    h->running = 0;
+}
+
+static void lshist_record(LS_Histogram *h, int64_t value, int64_t count) {
+    h->counts[lshist_index(h, value)] += count;
+    if (h->count == 0 || value < h->min) h->min = value;
+    if (h->count == 0 || value > h->max) h->max = value;
+    h->count += count;
+    h->sum += (double)value * count;
+}
+
+static LS_Histogram *lshist_check(lua_State *L, int index) {
+    return (LS_Histogram *)luaL_checkudata(L, index, HISTOGRAM_MT_NAME);
+}
+
+// gets a non-negative integer value; accepts floats, so also on Lua < 5.3
+static int64_t lshist_checkvalue(lua_State *L, int index) {
+    int64_t value;
+#if LUA_VERSION_NUM >= 503
+    if (lua_isinteger(L, index)) {
+        value = lua_tointeger(L, index);
+    } else
+#endif
+    {
+        value = (int64_t)luaL_checknumber(L, index);
+    }
+    luaL_argcheck(L, value >= 0, index, "value must not be negative");
+    return value;
+}
+
+
+
+/***
+Creates a new histogram.
+@function system.histogram
+@tparam[opt=7] int precision the number of bits of precision (2 to 12). Higher values are more accurate,
+but use more memory (for 7 bits 29kb, every extra bit doubles it).
+@treturn histogram the new histogram
+@usage
+local sys = require 'system'
+local hist = sys.histogram()
+
+for i = 1, 1000 do
+  hist:start()
+  -- do the work to measure
+  hist:stop()
+end
+
+print("median: ", hist:percentile(50), "ns")
+print("p99: ", hist:percentile(99), "ns")
+*/
+static int lshist_new(lua_State *L) {
+    int precision = (int)luaL_optinteger(L, 1, 7);
+    luaL_argcheck(L, precision >= HISTOGRAM_MIN_PRECISION && precision <= HISTOGRAM_MAX_PRECISION,
+                  1, "precision must be between 2 and 12");
+
+    // the largest value is INT64_MAX, so its bucket determines the count
+    int64_t half = (int64_t)1 << (precision - 1);
+    int shift = 62 - (precision - 1);
+    int bucket_count = (int)(shift * half + 2 * half);
+
+    LS_Histogram *h = (LS_Histogram *)lua_newuserdata(L, sizeof(LS_Histogram) + sizeof(int64_t) * (bucket_count - 1));
+    h->precision = precision;
+    h->bucket_count = bucket_count;
+    lshist_reset(h);
+    luaL_getmetatable(L, HISTOGRAM_MT_NAME);
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+/***
+Records a value.
+@function histogram:record
+@tparam int value the value to record, must not be negative. Typically a duration in nanoseconds.
+@tparam[opt=1] int count the number of times to record the value
+*/
+static int lshist_lua_record(lua_State *L) {
+    LS_Histogram *h = lshist_check(L, 1);
+    int64_t value = lshist_checkvalue(L, 2);
+    int64_t count = (int64_t)luaL_optinteger(L, 3, 1);
+    luaL_argcheck(L, count >= 0, 3, "count must not be negative");
+    if (count > 0) lshist_record(h, value, count);
+    return 0;
+}
+
+/***
+Starts the stopwatch.
+Use `histogram:stop` to record the elapsed time in nanoseconds. Only a single measurement
+can be in progress at a time, starting again restarts it.
+@function histogram:start
+*/
+static int lshist_lua_start(lua_State *L) {
+    LS_Histogram *h = lshist_check(L, 1);
+    h->running = 1;
+    h->started = time_monotime_ns();
+    return 0;
+}
+
+/***
+Stops the stopwatch, and records the elapsed time.
+@function histogram:stop
+@treturn int the elapsed time in nanoseconds since `histogram:start`.
+*/
+static int lshist_lua_stop(lua_State *L) {
+    int64_t now = time_monotime_ns();
+    LS_Histogram *h = lshist_check(L, 1);
+    if (!h->running) {
+        return luaL_error(L, "stopwatch was not started");
+    }
+    h->running = 0;
+    lshist_record(h, now - h->started, 1);
+    ls_pushint64(L, now - h->started);
+    return 1;
+}
+
+/***
+Returns the value at a percentile.
+The result is the highest value equivalent to the bucket the percentile falls in, limited
+to the range of recorded values.
+@function histogram:percentile
+@tparam number p the percentile (0 to 100), eg. 99.9
+@treturn int the value at the percentile, or 0 if nothing was recorded
+*/
+static int lshist_lua_percentile(lua_State *L) {
+    LS_Histogram *h = lshist_check(L, 1);
+    lua_Number p = luaL_checknumber(L, 2);
+    luaL_argcheck(L, p >= 0.0 && p <= 100.0, 2, "percentile must be between 0 and 100");
+
+    if (h->count == 0) {
+        ls_pushint64(L, 0);
+        return 1;
+    }
+
+    int64_t target = (int64_t)(p / 100.0 * h->count + 0.5);
+    if (target < 1) target = 1;
+    if (target > h->count) target = h->count;
+
+    int64_t total = 0;
+    int64_t value = h->max;
+    for (int i = 0; i < h->bucket_count; i++) {
+        total += h->counts[i];
+        if (total >= target) {
+            value = lshist_highest(h, i);
+            break;
+        }
+    }
+    if (value < h->min) value = h->min;
+    if (value > h->max) value = h->max;
+    ls_pushint64(L, value);
+    return 1;
+}
+
+/***
+Returns the number of values recorded.
+@function histogram:count
+@treturn int the number of values
+*/
+static int lshist_lua_count(lua_State *L) {
+    ls_pushint64(L, lshist_check(L, 1)->count);
+    return 1;
+}
+
+/***
+Returns the smallest value recorded.
+@function histogram:min
+@treturn int the smallest value, or 0 if nothing was recorded
+*/
+static int lshist_lua_min(lua_State *L) {
+    ls_pushint64(L, lshist_check(L, 1)->min);
+    return 1;
+}
+
+/***
+Returns the largest value recorded.
+@function histogram:max
+@treturn int the largest value, or 0 if nothing was recorded
+*/
+static int lshist_lua_max(lua_State *L) {
+    ls_pushint64(L, lshist_check(L, 1)->max);
+    return 1;
+}
+
+/***
+Returns the mean of the values recorded.
+@function histogram:mean
+@treturn number the mean, or 0 if nothing was recorded
+*/
+static int lshist_lua_mean(lua_State *L) {
+    LS_Histogram *h = lshist_check(L, 1);
+    lua_pushnumber(L, h->count == 0 ? 0.0 : h->sum / h->count);
+    return 1;
+}
+
+/***
+Adds the values recorded in another histogram.
+Both histograms must have the same precision.
+@function histogram:merge
+@tparam histogram other the histogram to add, it remains unchanged.
+*/
+static int lshist_lua_merge(lua_State *L) {
+    LS_Histogram *h = lshist_check(L, 1);
+    LS_Histogram *other = lshist_check(L, 2);
+    luaL_argcheck(L, h->precision == other->precision, 2, "histograms must have the same precision");
+    if (other->count == 0) return 0;
+
+    for (int i = 0; i < h->bucket_count; i++) {
+        h->counts[i] += other->counts[i];
+    }
+    if (h->count == 0 || other->min < h->min) h->min = other->min;
+    if (h->count == 0 || other->max > h->max) h->max = other->max;
+    h->count += other->count;
+    h->sum += other->sum;
+    return 0;
+}
+
+/***
+Clears all recorded values.
+@function histogram:reset
+*/
+static int lshist_lua_reset(lua_State *L) {
+    lshist_reset(lshist_check(L, 1));
+    return 0;
+}
+
+static int lshist_tostring(lua_State *L) {
+    LS_Histogram *h = lshist_check(L, 1);
+    lua_pushfstring(L, "histogram: %d values", (int)h->count);
+    return 1;
+}
+
+static const struct luaL_Reg lshist_funcs[] = {
+    {"histogram", lshist_new},
+    {NULL, NULL}
+};
+
+static const struct luaL_Reg lshist_methods[] = {
+    {"record", lshist_lua_record},
+    {"start", lshist_lua_start},
+    {"stop", lshist_lua_stop},
+    {"percentile", lshist_lua_percentile},
+    {"count", lshist_lua_count},
+    {"min", lshist_lua_min},
+    {"max", lshist_lua_max},
+    {"mean", lshist_lua_mean},
+    {"merge", lshist_lua_merge},
+    {"reset", lshist_lua_reset},
+    {"__tostring", lshist_tostring},
+    {NULL, NULL}
+};
+
+void histogram_open(lua_State *L) {
+    luaL_newmetatable(L, HISTOGRAM_MT_NAME);
+    luaL_setfuncs(L, lshist_methods, 0);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
+    luaL_setfuncs(L, lshist_funcs, 0);
+}
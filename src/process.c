@@ -0,0 +1,402 @@
+/// @module system
+
+/// Processes.
+// @section process
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE  // for posix_spawn_file_actions_addchdir_np
+#endif
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "compat.h"
+#include "sysenv.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#define HAVE_SPAWN_CHDIR 1  // posix_spawn_file_actions_addchdir_np
+#endif
+#endif
+
+#define ENVBLOCK_MT_NAME "LuaSystem.EnvBlock"
+
+// an environment block, as passed to posix_spawn: a NULL terminated array of
+// "name=value" strings, with the strings stored after it in the same allocation
+typedef struct {
+    int count;
+    char *entries[1];
+} LS_EnvBlock;
+
+
+static void process_pusherror(lua_State *L, const char *what, int err) {
+    lua_pushnil(L);
+    lua_pushfstring(L, "%s: %s", what, strerror(err));
+}
+
+
+
+/***
+Creates an environment block, for use with `spawn`.
+The block is prepared once, and can be reused for any number of processes, so the
+environment does not need to be converted again for every process.
+@function envblock
+@tparam table env table with variable names as keys, and their values (strings or numbers).
+Use `getenvs` to start from the current environment.
+@treturn envblock the environment block
+@usage
+local sys = require 'system'
+local env = sys.getenvs()
+env.LANG = "C"
+local block = sys.envblock(env)
+
+for _, file in ipairs(files) do
+  local pid = assert(sys.spawn({ "gzip", file }, { env = block }))
+  sys.waitpid(pid)
+end
+*/
+static int lua_envblock(lua_State *L) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_settop(L, 1);
+
+    // first pass: validate, count and measure
+    int count = 0;
+    size_t size = 0;
+    lua_pushnil(L);
+    while (lua_next(L, 1) != 0) {
+        size_t name_len, value_len;
+        if (lua_type(L, -2) != LUA_TSTRING) {
+            return luaL_argerror(L, 1, "variable names must be strings");
+        }
+        const char *name = lua_tolstring(L, -2, &name_len);
+        if (name_len == 0 || strchr(name, '=') != NULL) {
+            return luaL_argerror(L, 1, lua_pushfstring(L, "invalid variable name '%s'", name));
+        }
+        int type = lua_type(L, -1);
+        if (type != LUA_TSTRING && type != LUA_TNUMBER) {
+            return luaL_argerror(L, 1, lua_pushfstring(L, "value of '%s' must be a string", name));
+        }
+        lua_pushvalue(L, -1);  // convert a copy, lua_tolstring on a number would confuse lua_next
+        lua_tolstring(L, -1, &value_len);
+        lua_pop(L, 2);
+        size += name_len + value_len + 2;
+        count++;
+    }
+
+    LS_EnvBlock *block = (LS_EnvBlock *)lua_newuserdata(L, sizeof(LS_EnvBlock) + count * sizeof(char *) + size);
+    block->count = count;
+    char *data = (char *)&block->entries[count + 1];
+
+    // second pass: copy
+    int i = 0;
+    lua_pushnil(L);
+    while (lua_next(L, 1) != 0 && i < count) {
+        size_t name_len, value_len;
+        const char *name = lua_tolstring(L, -2, &name_len);
+        lua_pushvalue(L, -1);
+        const char *value = lua_tolstring(L, -1, &value_len);
+        block->entries[i++] = data;
+        memcpy(data, name, name_len);
+        data[name_len] = '=';
+        memcpy(data + name_len + 1, value, value_len + 1);
+        data += name_len + value_len + 2;
+        lua_pop(L, 2);
+    }
+    block->entries[i] = NULL;
+    block->count = i;
+    lua_settop(L, 2);
+
+    luaL_getmetatable(L, ENVBLOCK_MT_NAME);
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+static int envblock_len(lua_State *L) {
+    LS_EnvBlock *block = (LS_EnvBlock *)luaL_checkudata(L, 1, ENVBLOCK_MT_NAME);
+    lua_pushinteger(L, block->count);
+    return 1;
+}
+
+static int envblock_tostring(lua_State *L) {
+    LS_EnvBlock *block = (LS_EnvBlock *)luaL_checkudata(L, 1, ENVBLOCK_MT_NAME);
+    lua_pushfstring(L, "envblock: %d variables", block->count);
+    return 1;
+}
+
+
+
+#ifndef _WIN32
+// Adds the file action for one of the standard streams, from the option 'name' in
+// the table at 'opts'. Returns 0, an error number, or -1 for a bad option.
+static int process_stdio(lua_State *L, int opts, const char *name, int target,
+                         posix_spawn_file_actions_t *actions) {
+    int err = 0;
+    lua_getfield(L, opts, name);
+    switch (lua_type(L, -1)) {
+        case LUA_TNIL:
+            break;  // inherit
+
+        case LUA_TBOOLEAN:
+            if (lua_toboolean(L, -1)) {
+                err = -1;
+                break;
+            }
+            err = posix_spawn_file_actions_addopen(actions, target, "/dev/null",
+                                                   target == 0 ? O_RDONLY : O_WRONLY, 0);
+            break;
+
+        case LUA_TSTRING:
+            err = posix_spawn_file_actions_addopen(actions, target, lua_tostring(L, -1),
+                                                   target == 0 ? O_RDONLY : O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            break;
+
+        case LUA_TNUMBER:
+            err = posix_spawn_file_actions_adddup2(actions, (int)lua_tointeger(L, -1), target);
+            break;
+
+        default: {
+            FILE *fh = ls_tofile(L, -1);  // NULL if not a file, or closed
+            if (fh == NULL) {
+                err = -1;
+                break;
+            }
+            fflush(fh);
+            err = posix_spawn_file_actions_adddup2(actions, fileno(fh), target);
+            break;
+        }
+    }
+    lua_pop(L, 1);
+    return err;
+}
+#endif
+
+
+
+/***
+Starts a new process.
+The program is started directly (not through a shell), with `posix_spawn`. If its name
+does not contain a `/`, it is searched for in `PATH`.
+
+The standard streams (`stdin`, `stdout`, `stderr` options) are inherited, unless they are
+set to one of:
+
+- a Lua file handle (eg. from `io.open`)
+- a file name (opened for reading for `stdin`, or truncated for writing otherwise)
+- a file descriptor number
+- `false` to connect it to `/dev/null`
+
+Not available on Windows.
+@function spawn
+@tparam table argv the program and its arguments, eg. `{ "ls", "-l" }`
+@tparam[opt] table opts options table with the following (optional) fields:
+@tparam[opt] envblock|table opts.env the environment, defaults to the current environment
+(the copy, if `sharedenv` is enabled).
+An `envblock` can be reused, a table is converted on every call (like `envblock`).
+@tparam[opt] string opts.cwd the working directory (requires glibc 2.29 or newer)
+@tparam[opt] file|string|int|false opts.stdin standard input
+@tparam[opt] file|string|int|false opts.stdout standard output
+@tparam[opt] file|string|int|false opts.stderr standard error
+@treturn[1] int the process id
+@treturn[2] nil
+@treturn[2] string error message
+@usage
+local sys = require 'system'
+local pid = assert(sys.spawn({ "make", "-j4" }, { stdout = "build.log", stderr = false }))
+local how, code = sys.waitpid(pid)
+print(how, code)  -- "exit", 0
+*/
+static int lua_spawn(lua_State *L) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    if (!lua_isnoneornil(L, 2)) luaL_checktype(L, 2, LUA_TTABLE);
+    lua_settop(L, 2);
+
+    // validate argv first, so bad arguments raise the same errors on every platform
+    int argc = (int)lua_rawlen(L, 1);
+    luaL_argcheck(L, argc > 0, 1, "must contain at least the program");
+    for (int i = 0; i < argc; i++) {
+        lua_rawgeti(L, 1, i + 1);
+        if (lua_type(L, -1) != LUA_TSTRING) {
+            return luaL_argerror(L, 1, "arguments must be strings");
+        }
+        lua_pop(L, 1);
+    }
+
+#ifdef _WIN32
+    lua_pushnil(L);
+    lua_pushliteral(L, "spawn is not supported on Windows");
+    return 2;
+#else
+    // argv; the strings remain referenced by the argv table
+    char **argv = (char **)lua_newuserdata(L, (argc + 1) * sizeof(char *));  // index 3
+    for (int i = 0; i < argc; i++) {
+        lua_rawgeti(L, 1, i + 1);
+        argv[i] = (char *)lua_tostring(L, -1);
+        lua_pop(L, 1);
+    }
+    argv[argc] = NULL;
+
+    // the environment; converted before creating the file actions, since it may raise errors
+    char **envp = environ;
+    if (!lua_isnil(L, 2)) {
+        lua_getfield(L, 2, "env");  // index 4
+        if (lua_type(L, 4) == LUA_TTABLE) {
+            lua_pushcfunction(L, lua_envblock);
+            lua_pushvalue(L, 4);
+            lua_call(L, 1, 1);
+            lua_replace(L, 4);
+        }
+        if (!lua_isnil(L, 4)) {
+            LS_EnvBlock *block = (LS_EnvBlock *)luaL_testudata(L, 4, ENVBLOCK_MT_NAME);
+            if (block == NULL) {
+                return luaL_error(L, "bad option 'env', expected an envblock or table");
+            }
+            envp = block->entries;
+        }
+    }
+
+    posix_spawn_file_actions_t actions;
+    int err = posix_spawn_file_actions_init(&actions);
+    if (err != 0) {
+        process_pusherror(L, "failed to spawn", err);
+        return 2;
+    }
+
+    if (!lua_isnil(L, 2)) {
+        lua_getfield(L, 2, "cwd");
+        if (!lua_isnil(L, -1)) {
+            const char *cwd = lua_tostring(L, -1);
+            if (cwd == NULL) {
+                posix_spawn_file_actions_destroy(&actions);
+                return luaL_error(L, "bad option 'cwd', expected a string");
+            }
+#ifdef HAVE_SPAWN_CHDIR
+            err = posix_spawn_file_actions_addchdir_np(&actions, cwd);
+#else
+            posix_spawn_file_actions_destroy(&actions);
+            lua_pushnil(L);
+            lua_pushliteral(L, "option 'cwd' is not supported on this platform");
+            return 2;
+#endif
+        }
+        lua_pop(L, 1);  // the cwd string is copied by addchdir_np
+
+        static const char *const streams[] = { "stdin", "stdout", "stderr" };
+        for (int fd = 0; fd < 3 && err == 0; fd++) {
+            err = process_stdio(L, 2, streams[fd], fd, &actions);
+            if (err < 0) {
+                posix_spawn_file_actions_destroy(&actions);
+                return luaL_error(L, "bad option '%s', expected a file, path, fd, or false", streams[fd]);
+            }
+        }
+        if (err != 0) {
+            posix_spawn_file_actions_destroy(&actions);
+            process_pusherror(L, "failed to spawn", err);
+            return 2;
+        }
+    }
+
+    // with the shared environment enabled, 'environ' may be replaced by setenv in another thread
+    LS_EnvSnapshot *snapshot = envp == environ ? env_snapshot_acquire() : NULL;
+    if (snapshot != NULL) {
+        envp = snapshot->entries;
+    }
+
+    pid_t pid;
+    err = posix_spawnp(&pid, argv[0], &actions, NULL, argv, envp);
+    posix_spawn_file_actions_destroy(&actions);
+    if (snapshot != NULL) {
+        env_snapshot_release(snapshot);
+    }
+    if (err != 0) {
+        process_pusherror(L, lua_pushfstring(L, "failed to spawn '%s'", argv[0]), err);
+        return 2;
+    }
+
+    lua_pushinteger(L, (lua_Integer)pid);
+    return 1;
+#endif
+}
+
+
+
+/***
+Waits for a process started with `spawn` to end.
+Not available on Windows.
+@function waitpid
+@tparam int pid the process id
+@tparam[opt=false] boolean nohang if truthy, do not wait, but return `"running"` if the
+process did not end yet
+@treturn[1] string `"exit"`, or `"signal"` if the process was killed by a signal
+@treturn[1] int the exit code, or the signal number
+@treturn[2] string `"running"`, if `nohang` was set and the process did not end yet
+@treturn[3] nil
+@treturn[3] string error message
+*/
+static int lua_waitpid(lua_State *L) {
+    lua_Integer pid = luaL_checkinteger(L, 1);
+    int nohang = lua_toboolean(L, 2);
+    luaL_argcheck(L, pid > 0, 1, "must be a process id");
+
+#ifdef _WIN32
+    (void)nohang;
+    lua_pushnil(L);
+    lua_pushliteral(L, "waitpid is not supported on Windows");
+    return 2;
+#else
+    int status;
+    pid_t result;
+    do {
+        result = waitpid((pid_t)pid, &status, nohang ? WNOHANG : 0);
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0) {
+        process_pusherror(L, "waitpid failed", errno);
+        return 2;
+    }
+    if (result == 0) {
+        lua_pushliteral(L, "running");
+        return 1;
+    }
+    if (WIFSIGNALED(status)) {
+        lua_pushliteral(L, "signal");
+        lua_pushinteger(L, WTERMSIG(status));
+    } else {
+        lua_pushliteral(L, "exit");
+        lua_pushinteger(L, WEXITSTATUS(status));
+    }
+    return 2;
+#endif
+}
+
+
+
+static luaL_Reg func[] = {
+    { "envblock", lua_envblock },
+    { "spawn", lua_spawn },
+    { "waitpid", lua_waitpid },
+    { NULL, NULL }
+};
+
+/*-------------------------------------------------------------------------
+ * Initializes module
+ *-------------------------------------------------------------------------*/
+void process_open(lua_State *L) {
+    luaL_newmetatable(L, ENVBLOCK_MT_NAME);
+    lua_pushcfunction(L, envblock_len);
+    lua_setfield(L, -2, "__len");
+    lua_pushcfunction(L, envblock_tostring);
+    lua_setfield(L, -2, "__tostring");
+    lua_pop(L, 1);
+
+    luaL_setfuncs(L, func, 0);
+}
@@ -7,7 +7,13 @@
 #include <lua.h>
 #include <lauxlib.h>
 #include "compat.h"
+#include "sysrandom.h"
+#include "systime.h"
 #include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #ifdef _WIN32
     #include <windows.h>
@@ -15,7 +21,7 @@
 #else
     #include <errno.h>
     #include <unistd.h>
-    #include <string.h>
+    #include <sys/types.h>
     #if defined(__linux__)
         // getrandom() requires random.h and is available from glibc 2.25
         #if !defined(__GLIBC__) || (__GLIBC__ < 2 || __GLIBC_MINOR__ < 25)
@@ -23,52 +29,25 @@
         #else
             #include <sys/random.h> // getrandom()
         #endif
+        #include <sys/mman.h>   // MADV_WIPEONFORK
     #elif defined(__APPLE__) || defined(__unix__)
         #include <stdlib.h>     // arc4random_buf()
     #endif
 #endif
 
 
-/***
-Generate random bytes.
-This uses `BCryptGenRandom()` on Windows, `getrandom()` on Linux, `arc4random_buf` on BSD,
-and `/dev/urandom` on other platforms. It will return the
-requested number of bytes, or an error, never a partial result.
-@function random
-@tparam[opt=1] int length number of bytes to get
-@treturn[1] string string of random bytes
-@treturn[2] nil
-@treturn[2] string error message
-*/
-static int lua_get_random_bytes(lua_State* L) {
-    int num_bytes = luaL_optinteger(L, 1, 1); // Number of bytes, default to 1 if not provided
-
-    if (num_bytes <= 0) {
-        if (num_bytes == 0) {
-            lua_pushliteral(L, "");
-            return 1;
-        }
-        lua_pushnil(L);
-        lua_pushstring(L, "invalid number of bytes, must not be less than 0");
-        return 2;
-    }
-
-    unsigned char* buffer = (unsigned char*)lua_newuserdata(L, num_bytes);
-    if (buffer == NULL) {
-        lua_pushnil(L);
-        lua_pushstring(L, "failed to allocate memory for random buffer");
-        return 2;
-    }
-
-    ssize_t total_read = 0;
+// Fills the buffer with random bytes from the OS. Returns 1 on success. On
+// failure it pushes nil and an error message, and returns 0.
+int random_os_bytes(lua_State *L, unsigned char *buffer, size_t num_bytes) {
+    size_t total_read = 0;
 
 #ifdef _WIN32
     // Use BCryptGenRandom() on Windows
-    if (!BCRYPT_SUCCESS(BCryptGenRandom(NULL, buffer, num_bytes, BCRYPT_USE_SYSTEM_PREFERRED_RNG))) {
+    if (!BCRYPT_SUCCESS(BCryptGenRandom(NULL, buffer, (ULONG)num_bytes, BCRYPT_USE_SYSTEM_PREFERRED_RNG))) {
         DWORD error = GetLastError();
         lua_pushnil(L);
         lua_pushfstring(L, "failed to get random data: %lu", error);
-        return 2;
+        return 0;
     }
 
 #elif defined(__linux__) && !defined(USE_DEV_URANDOM)
@@ -79,13 +58,15 @@ static int lua_get_random_bytes(lua_State* L) {
             if (errno == EINTR) continue;  // Retry on interrupt
             lua_pushnil(L);
             lua_pushfstring(L, "getrandom() failed: %s", strerror(errno));
-            return 2;
+            return 0;
         }
         total_read += n;
     }
 
 #elif defined(__APPLE__) || (defined(__unix__) && !defined(USE_DEV_URANDOM))
     // Use arc4random_buf() on BSD/macOS
+    (void)L;
+    (void)total_read;
     arc4random_buf(buffer, num_bytes);
 
 #else
@@ -94,7 +75,7 @@ static int lua_get_random_bytes(lua_State* L) {
     if (fd < 0) {
         lua_pushnil(L);
         lua_pushstring(L, "failed opening /dev/urandom");
-        return 2;
+        return 0;
     }
 
     while (total_read < num_bytes) {
@@ -108,7 +89,7 @@ static int lua_get_random_bytes(lua_State* L) {
                 lua_pushnil(L);
                 lua_pushfstring(L, "failed reading /dev/urandom: %s", strerror(errno));
                 close(fd);
-                return 2;
+                return 0;
             }
         }
 
@@ -118,7 +99,643 @@ static int lua_get_random_bytes(lua_State* L) {
     close(fd);
 #endif
 
-    lua_pushlstring(L, (const char*)buffer, num_bytes);
+    return 1;
+}
+
+
+#define RANDOM_CHUNK_SIZE (1 << 20)
+
+// Fills a buffer with random bytes from 'source'. Same return values as random_os_bytes.
+typedef int (*random_fill_fn)(lua_State *L, void *source, unsigned char *buffer, size_t num_bytes);
+
+// Pushes a string of 'num_bytes' random bytes. They are generated straight into
+// the result buffer, in chunks of RANDOM_CHUNK_SIZE. Returns the number of results
+// (1, or 2 for nil and an error message).
+static int random_pushbytes(lua_State *L, size_t num_bytes, random_fill_fn fill, void *source) {
+    luaL_Buffer b;
+    unsigned char *buffer = (unsigned char *)ls_buffinitsize(L, &b, num_bytes);
+    for (size_t offset = 0; offset < num_bytes; offset += RANDOM_CHUNK_SIZE) {
+        size_t n = num_bytes - offset;
+        if (n > RANDOM_CHUNK_SIZE) n = RANDOM_CHUNK_SIZE;
+        if (!fill(L, source, buffer + offset, n)) {
+            return 2;
+        }
+    }
+    ls_pushresultsize(&b, num_bytes);
+    return 1;
+}
+
+static int random_os_fill(lua_State *L, void *source, unsigned char *buffer, size_t num_bytes) {
+    (void)source;
+    return random_os_bytes(L, buffer, num_bytes);
+}
+
+
+
+/***
+Generate random bytes.
+This uses `BCryptGenRandom()` on Windows, `getrandom()` on Linux, `arc4random_buf` on BSD,
+and `/dev/urandom` on other platforms. It will return the
+requested number of bytes, or an error, never a partial result.
+
+Every call goes to the OS. For many small requests `fastrandom` is faster.
+@function random
+@tparam[opt=1] int length number of bytes to get
+@treturn[1] string string of random bytes
+@treturn[2] nil
+@treturn[2] string error message
+*/
+static int lua_get_random_bytes(lua_State* L) {
+    int num_bytes = luaL_optinteger(L, 1, 1); // Number of bytes, default to 1 if not provided
+
+    if (num_bytes <= 0) {
+        if (num_bytes == 0) {
+            lua_pushliteral(L, "");
+            return 1;
+        }
+        lua_pushnil(L);
+        lua_pushstring(L, "invalid number of bytes, must not be less than 0");
+        return 2;
+    }
+
+    return random_pushbytes(L, num_bytes, random_os_fill, NULL);
+}
+
+
+
+/*-------------------------------------------------------------------------
+ * ChaCha20 pool
+ *
+ * A userspace CSPRNG, keyed from the OS. The keystream is generated in
+ * blocks of RANDOM_POOL_SIZE bytes. After every refill the first bytes of
+ * the new block become the next key ("fast key erasure"), and bytes are
+ * wiped from the pool once handed out. So a later memory disclosure does
+ * not reveal earlier output. Every RANDOM_RESEED_BYTES the key is replaced
+ * with fresh bytes from the OS.
+ *
+ * After a fork, parent and child would produce the same stream. On Linux
+ * the pool lives in a page marked MADV_WIPEONFORK, so the child finds it
+ * zeroed (not seeded). Elsewhere, or on older kernels, the pid is checked.
+ *-------------------------------------------------------------------------*/
+
+#define RANDOM_POOL_MT_NAME "LuaSystem.RandomPool"
+
+#define RANDOM_KEY_SIZE 32
+#define RANDOM_IV_SIZE 8
+#define RANDOM_POOL_SIZE 1024           // 16 ChaCha20 blocks
+#define RANDOM_RESEED_BYTES (1 << 20)   // reseed from the OS every 1 MiB
+
+typedef struct {
+    int seeded;                         // zero after a fork with MADV_WIPEONFORK
+    int check_pid;                      // detect forks by pid
+#ifndef _WIN32
+    pid_t pid;                          // process that seeded the pool
+#endif
+    size_t available;                   // unused bytes at the end of 'pool'
+    size_t since_reseed;                // bytes generated since the last reseed
+    uint32_t input[16];                 // ChaCha20 state: constants, key, counter, iv
+    unsigned char pool[RANDOM_POOL_SIZE];
+} LS_RandomPool;
+
+typedef struct {
+    LS_RandomPool *pool;
+    int mapped;                         // allocated with mmap
+} LS_RandomPoolRef;
+
+
+#define CHACHA_ROTL(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define CHACHA_QR(a, b, c, d) \
+    a += b; d ^= a; d = CHACHA_ROTL(d, 16); \
+    c += d; b ^= c; b = CHACHA_ROTL(b, 12); \
+    a += b; d ^= a; d = CHACHA_ROTL(d, 8);  \
+    c += d; b ^= c; b = CHACHA_ROTL(b, 7);
+
+static uint32_t chacha_load32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void chacha_store32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+// sets the key and iv (RANDOM_KEY_SIZE + RANDOM_IV_SIZE bytes), resets the counter
+static void chacha_keysetup(uint32_t *input, const unsigned char *key_iv) {
+    input[0] = 0x61707865;  // "expand 32-byte k"
+    input[1] = 0x3320646e;
+    input[2] = 0x79622d32;
+    input[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++) {
+        input[4 + i] = chacha_load32(key_iv + 4 * i);
+    }
+    input[12] = 0;
+    input[13] = 0;
+    input[14] = chacha_load32(key_iv + RANDOM_KEY_SIZE);
+    input[15] = chacha_load32(key_iv + RANDOM_KEY_SIZE + 4);
+}
+
+// writes 'blocks' blocks of 64 bytes of keystream, and advances the 64-bit counter
+static void chacha_blocks(uint32_t *input, unsigned char *out, size_t blocks) {
+    while (blocks--) {
+        uint32_t x[16];
+        memcpy(x, input, sizeof(x));
+        for (int i = 0; i < 10; i++) {
+            CHACHA_QR(x[0], x[4], x[8],  x[12])
+            CHACHA_QR(x[1], x[5], x[9],  x[13])
+            CHACHA_QR(x[2], x[6], x[10], x[14])
+            CHACHA_QR(x[3], x[7], x[11], x[15])
+            CHACHA_QR(x[0], x[5], x[10], x[15])
+            CHACHA_QR(x[1], x[6], x[11], x[12])
+            CHACHA_QR(x[2], x[7], x[8],  x[13])
+            CHACHA_QR(x[3], x[4], x[9],  x[14])
+        }
+        for (int i = 0; i < 16; i++) {
+            chacha_store32(out + 4 * i, x[i] + input[i]);
+        }
+        out += 64;
+        if (++input[12] == 0) input[13]++;
+    }
+}
+
+
+// Seeds the pool from the OS. On failure it pushes nil and an error message, and returns 0.
+static int random_pool_seed(lua_State *L, LS_RandomPool *p) {
+    unsigned char key_iv[RANDOM_KEY_SIZE + RANDOM_IV_SIZE];
+    if (!random_os_bytes(L, key_iv, sizeof(key_iv))) {
+        return 0;
+    }
+    chacha_keysetup(p->input, key_iv);
+    memset(key_iv, 0, sizeof(key_iv));
+    p->available = 0;
+    p->since_reseed = 0;
+#ifndef _WIN32
+    p->pid = getpid();
+#endif
+    p->seeded = 1;
+    return 1;
+}
+
+// generates a new block of bytes, and rekeys from the start of it
+static void random_pool_refill(LS_RandomPool *p) {
+    chacha_blocks(p->input, p->pool, RANDOM_POOL_SIZE / 64);
+    chacha_keysetup(p->input, p->pool);
+    memset(p->pool, 0, RANDOM_KEY_SIZE + RANDOM_IV_SIZE);
+    p->available = RANDOM_POOL_SIZE - RANDOM_KEY_SIZE - RANDOM_IV_SIZE;
+    p->since_reseed += RANDOM_POOL_SIZE;
+}
+
+// Fills the buffer from the pool. On failure (seeding) it pushes nil and an error message, and returns 0.
+static int random_pool_bytes(lua_State *L, LS_RandomPool *p, unsigned char *buffer, size_t num_bytes) {
+#ifndef _WIN32
+    if (p->seeded && p->check_pid && p->pid != getpid()) {
+        p->seeded = 0;  // forked
+    }
+#endif
+    if (!p->seeded || p->since_reseed >= RANDOM_RESEED_BYTES) {
+        if (!random_pool_seed(L, p)) return 0;
+    }
+
+    while (num_bytes > 0) {
+        if (p->available == 0) {
+            random_pool_refill(p);
+        }
+        size_t n = num_bytes < p->available ? num_bytes : p->available;
+        unsigned char *src = p->pool + RANDOM_POOL_SIZE - p->available;
+        memcpy(buffer, src, n);
+        memset(src, 0, n);
+        p->available -= n;
+        buffer += n;
+        num_bytes -= n;
+    }
+    return 1;
+}
+
+static int random_pool_fill(lua_State *L, void *source, unsigned char *buffer, size_t num_bytes) {
+    return random_pool_bytes(L, (LS_RandomPool *)source, buffer, num_bytes);
+}
+
+static LS_RandomPool *random_pool_alloc(int *mapped) {
+    LS_RandomPool *p = NULL;
+    *mapped = 0;
+#if defined(__linux__) && defined(MADV_WIPEONFORK)
+    p = (LS_RandomPool *)mmap(NULL, sizeof(LS_RandomPool), PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        p = NULL;
+    } else {
+        *mapped = 1;
+        if (madvise(p, sizeof(LS_RandomPool), MADV_WIPEONFORK) == 0) {
+            return p;  // mmap returns zeroed memory, so 'seeded' and 'check_pid' are 0
+        }
+    }
+#endif
+    if (p == NULL) {
+        p = (LS_RandomPool *)malloc(sizeof(LS_RandomPool));
+        if (p == NULL) return NULL;
+    }
+    memset(p, 0, sizeof(LS_RandomPool));
+#ifndef _WIN32
+    p->check_pid = 1;  // no MADV_WIPEONFORK (old kernel, or not Linux)
+#endif
+    return p;
+}
+
+static int random_pool_gc(lua_State *L) {
+    LS_RandomPoolRef *ref = (LS_RandomPoolRef *)luaL_checkudata(L, 1, RANDOM_POOL_MT_NAME);
+    if (ref->pool != NULL) {
+        memset(ref->pool, 0, sizeof(LS_RandomPool));
+#if defined(__linux__) && defined(MADV_WIPEONFORK)
+        if (ref->mapped) {
+            munmap(ref->pool, sizeof(LS_RandomPool));
+        } else
+#endif
+        {
+            free(ref->pool);
+        }
+        ref->pool = NULL;
+    }
+    return 0;
+}
+
+
+
+/***
+Generate random bytes, from a userspace pool.
+This is a ChaCha20 based CSPRNG, seeded from the same OS source as `random`. It is reseeded
+every MiB of output, and after a fork. Since most calls do not need a system call, it is much
+faster for small requests, like generating tokens or ids.
+
+The pool is per Lua state. So, like the Lua state itself, it should not be used from multiple
+threads at the same time.
+@function fastrandom
+@tparam[opt=1] int length number of bytes to get
+@treturn[1] string string of random bytes
+@treturn[2] nil
+@treturn[2] string error message
+*/
+static int lua_get_fastrandom_bytes(lua_State* L) {
+    LS_RandomPoolRef *ref = (LS_RandomPoolRef *)lua_touserdata(L, lua_upvalueindex(1));
+    int num_bytes = luaL_optinteger(L, 1, 1);
+
+    if (num_bytes <= 0) {
+        if (num_bytes == 0) {
+            lua_pushliteral(L, "");
+            return 1;
+        }
+        lua_pushnil(L);
+        lua_pushstring(L, "invalid number of bytes, must not be less than 0");
+        return 2;
+    }
+
+    if (ref->pool == NULL) {
+        ref->pool = random_pool_alloc(&ref->mapped);
+        if (ref->pool == NULL) {
+            lua_pushnil(L);
+            lua_pushstring(L, "failed to allocate memory for random pool");
+            return 2;
+        }
+    }
+
+    return random_pushbytes(L, num_bytes, random_pool_fill, ref->pool);
+}
+
+
+
+/*-------------------------------------------------------------------------
+ * Bulk generation
+ *
+ * Random words are read from the OS in blocks of up to RANDOM_CHUNK_SIZE
+ * bytes, and reduced to the requested range in C. So generating many
+ * numbers takes a single call from Lua, and (mostly) a single read.
+ *-------------------------------------------------------------------------*/
+
+typedef struct {
+    uint64_t *words;
+    size_t size;        // number of words in the buffer
+    size_t pos;         // next unused word
+} LS_RandomWords;
+
+// Prepares a word source for about 'needed' words. Pushes the buffer (a userdata).
+static void random_words_init(lua_State *L, LS_RandomWords *w, size_t needed) {
+    size_t size = needed + 8;  // spare words for rejections
+    if (size > RANDOM_CHUNK_SIZE / sizeof(uint64_t)) {
+        size = RANDOM_CHUNK_SIZE / sizeof(uint64_t);
+    }
+    w->words = (uint64_t *)lua_newuserdata(L, size * sizeof(uint64_t));
+    w->size = size;
+    w->pos = size;
+}
+
+// Gets a value in [lo, lo + range), unbiased (Lemire's method). Range 0 is the
+// full 64-bit range, and 'threshold' must be (2^64 - range) % range. On failure
+// it pushes nil and an error message, and returns 0.
+static int random_words_int(lua_State *L, LS_RandomWords *w, int64_t lo, uint64_t range,
+                            uint64_t threshold, uint64_t *value) {
+    uint64_t low, result;
+    do {
+        if (w->pos == w->size) {
+            if (!random_os_bytes(L, (unsigned char *)w->words, w->size * sizeof(uint64_t))) {
+                return 0;
+            }
+            w->pos = 0;
+        }
+        uint64_t word = w->words[w->pos++];
+        if (range == 0) {
+            *value = word;
+            return 1;
+        }
+        result = rng_mul128(word, range, &low);
+    } while (low < threshold);
+    *value = (uint64_t)lo + result;
+    return 1;
+}
+
+// gets an integer argument; accepts floats, so also on Lua < 5.3
+static int64_t random_checkint(lua_State *L, int index) {
+#if LUA_VERSION_NUM >= 503
+    if (lua_isinteger(L, index)) {
+        return (int64_t)lua_tointeger(L, index);
+    }
+#endif
+    return (int64_t)luaL_checknumber(L, index);
+}
+
+static void random_store_le(unsigned char *p, uint64_t value, int size) {
+    for (int i = 0; i < size; i++) {
+        p[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+
+
+/***
+Generate random integers into a table.
+The numbers are drawn from the same OS source as `random`, in large reads, and reduced to
+the range without bias.
+@function randomints
+@tparam int n the number of integers
+@tparam int lo the lower bound (inclusive)
+@tparam int hi the upper bound (inclusive)
+@tparam[opt] table tbl the table to fill (at indices 1 to n), a new table is created if omitted
+@treturn[1] table the table with the random integers
+@treturn[2] nil
+@treturn[2] string error message
+@usage
+local sys = require 'system'
+local ids = sys.randomints(1000000, 1, 100000)
+*/
+static int lua_get_random_ints(lua_State *L) {
+    lua_Integer n = luaL_checkinteger(L, 1);
+    int64_t lo = random_checkint(L, 2);
+    int64_t hi = random_checkint(L, 3);
+    luaL_argcheck(L, n >= 0 && n < INT_MAX, 1, "invalid number of integers");
+    luaL_argcheck(L, lo <= hi, 3, "interval is empty");
+    if (lua_isnoneornil(L, 4)) {
+        lua_settop(L, 3);
+        lua_createtable(L, (int)n, 0);
+    } else {
+        luaL_checktype(L, 4, LUA_TTABLE);
+        lua_settop(L, 4);
+    }
+
+    uint64_t range = (uint64_t)hi - (uint64_t)lo + 1;
+    uint64_t threshold = range == 0 ? 0 : (0 - range) % range;
+    LS_RandomWords w;
+    random_words_init(L, &w, (size_t)n);
+
+    for (int i = 1; i <= (int)n; i++) {
+        uint64_t value;
+        if (!random_words_int(L, &w, lo, range, threshold, &value)) {
+            return 2;
+        }
+        ls_pushint64(L, (int64_t)value);
+        lua_rawseti(L, 4, i);
+    }
+
+    lua_settop(L, 4);
+    return 1;
+}
+
+
+
+static const char *const random_packed_formats[] = { "i4", "i8", "d", NULL };
+
+/***
+Generate random numbers, packed into a string.
+The numbers are drawn from the same OS source as `random`, in large reads. Integers are reduced
+to the range without bias. The result is little endian, and can be read with `string.unpack`
+(using formats "<i4", "<i8", or "<d"), or passed on to C code or files.
+@function randompacked
+@tparam int n the number of values
+@tparam string format one of `"i4"` (32-bit integers), `"i8"` (64-bit integers), or `"d"` (doubles).
+@tparam[opt] number lo the lower bound (inclusive). Defaults to the lowest value of the
+integer type, or 0 for doubles.
+@tparam[opt] number hi the upper bound (inclusive for integers, exclusive for doubles).
+Defaults to the highest value of the integer type, or 1 for doubles.
+@treturn[1] string the packed values, `n * 4` or `n * 8` bytes
+@treturn[2] nil
+@treturn[2] string error message
+@usage
+local sys = require 'system'
+local data = sys.randompacked(1000, "i4", 1, 6)
+local first = string.unpack("<i4", data, 1)
+*/
+static int lua_get_random_packed(lua_State *L) {
+    lua_Integer n = luaL_checkinteger(L, 1);
+    int format = luaL_checkoption(L, 2, NULL, random_packed_formats);
+    int size = format == 0 ? 4 : 8;
+    luaL_argcheck(L, n >= 0 && (size_t)n <= ((size_t)-1) / 8, 1, "invalid number of values");
+    size_t num_bytes = (size_t)n * size;
+
+    if (format == 2) {
+        // doubles
+        lua_Number lo = luaL_optnumber(L, 3, 0.0);
+        lua_Number hi = luaL_optnumber(L, 4, 1.0);
+        luaL_argcheck(L, lo < hi, 4, "interval is empty");
+        lua_settop(L, 4);
+
+        LS_RandomWords w;
+        random_words_init(L, &w, (size_t)n);
+        luaL_Buffer b;
+        unsigned char *buffer = (unsigned char *)ls_buffinitsize(L, &b, num_bytes);
+        for (size_t i = 0; i < (size_t)n; i++) {
+            uint64_t word, bits;
+            if (!random_words_int(L, &w, 0, 0, 0, &word)) {
+                return 2;
+            }
+            double value = lo + (hi - lo) * ((double)(word >> 11) * (1.0 / 9007199254740992.0));
+            if (value >= hi) value = lo;  // rounding
+            memcpy(&bits, &value, sizeof(bits));
+            random_store_le(buffer + i * 8, bits, 8);
+        }
+        ls_pushresultsize(&b, num_bytes);
+        return 1;
+    }
+
+    int64_t type_min = format == 0 ? INT32_MIN : INT64_MIN;
+    int64_t type_max = format == 0 ? INT32_MAX : INT64_MAX;
+    int64_t lo = lua_isnoneornil(L, 3) ? type_min : random_checkint(L, 3);
+    int64_t hi = lua_isnoneornil(L, 4) ? type_max : random_checkint(L, 4);
+    luaL_argcheck(L, lo >= type_min, 3, "value out of range");
+    luaL_argcheck(L, hi <= type_max, 4, "value out of range");
+    luaL_argcheck(L, lo <= hi, 4, "interval is empty");
+    lua_settop(L, 4);
+
+    if (lo == type_min && hi == type_max) {
+        // every bit pattern is valid, so use the bytes as they are
+        return random_pushbytes(L, num_bytes, random_os_fill, NULL);
+    }
+
+    uint64_t range = (uint64_t)hi - (uint64_t)lo + 1;
+    uint64_t threshold = (0 - range) % range;
+    LS_RandomWords w;
+    random_words_init(L, &w, (size_t)n);
+    luaL_Buffer b;
+    unsigned char *buffer = (unsigned char *)ls_buffinitsize(L, &b, num_bytes);
+    for (size_t i = 0; i < (size_t)n; i++) {
+        uint64_t value;
+        if (!random_words_int(L, &w, lo, range, threshold, &value)) {
+            return 2;
+        }
+        random_store_le(buffer + i * size, value, size);
+    }
+    ls_pushresultsize(&b, num_bytes);
+    return 1;
+}
+
+
+
+/*-------------------------------------------------------------------------
+ * UUIDs
+ *-------------------------------------------------------------------------*/
+
+#define UUID_BATCH_SIZE 4096    // uuids per read from the OS
+
+// the last version 7 timestamp and counter, to keep them ordered
+static LS_THREAD_LOCAL struct {
+    int64_t ms;
+    unsigned int counter;
+} uuid7_state;
+
+// Turns 16 random bytes into a version 4 or 7 uuid, in place.
+static void random_uuid_set(unsigned char *b, int version) {
+    if (version == 7) {
+        // 48-bit ms timestamp, and a 12-bit counter in 'rand_a' (RFC 9562, method 1).
+        // A new millisecond starts the counter at a random value below 2048, so there
+        // is room to count up. On overflow, or if the clock went back, the last
+        // timestamp is reused (and advanced), so the uuids are always increasing.
+        int64_t ms = time_gettime_ns() / 1000000;
+        unsigned int random_counter = ((unsigned int)b[6] << 8 | b[7]) & 0x7FF;
+        if (ms > uuid7_state.ms) {
+            uuid7_state.ms = ms;
+            uuid7_state.counter = random_counter;
+        } else if (++uuid7_state.counter > 0xFFF) {
+            uuid7_state.ms++;
+            uuid7_state.counter = random_counter;
+        }
+        ms = uuid7_state.ms;
+        for (int i = 5; i >= 0; i--) {
+            b[i] = (unsigned char)ms;
+            ms >>= 8;
+        }
+        b[6] = (unsigned char)(uuid7_state.counter >> 8);
+        b[7] = (unsigned char)uuid7_state.counter;
+    }
+    b[6] = (unsigned char)((b[6] & 0x0F) | (version << 4));
+    b[8] = (unsigned char)((b[8] & 0x3F) | 0x80);  // variant 10xx
+}
+
+// pushes the uuid in the canonical form (lowercase, 36 characters)
+static void random_uuid_push(lua_State *L, const unsigned char *b) {
+    static const char hex[] = "0123456789abcdef";
+    char out[36];
+    char *p = out;
+    for (int i = 0; i < 16; i++) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) *p++ = '-';
+        *p++ = hex[b[i] >> 4];
+        *p++ = hex[b[i] & 0x0F];
+    }
+    lua_pushlstring(L, out, sizeof(out));
+}
+
+static int random_uuid(lua_State *L, int version) {
+    unsigned char b[16];
+    if (!random_os_bytes(L, b, sizeof(b))) {
+        return 2;
+    }
+    random_uuid_set(b, version);
+    random_uuid_push(L, b);
+    return 1;
+}
+
+
+
+/***
+Generate a random (version 4) uuid.
+@function uuid4
+@treturn[1] string the uuid, eg. `"3b241101-e2bb-4255-8caf-4136c566a962"`
+@treturn[2] nil
+@treturn[2] string error message
+*/
+static int lua_uuid4(lua_State *L) {
+    return random_uuid(L, 4);
+}
+
+
+
+/***
+Generate a time ordered (version 7) uuid.
+The uuid starts with the system time in milliseconds. Within a thread, uuids are
+strictly increasing, also when generated within the same millisecond, or when
+the system clock is set back. So they sort in the order they were created, both as
+binary and as strings.
+@function uuid7
+@treturn[1] string the uuid, eg. `"018f3a6c-7f1a-7b3e-9c1d-4e5f6a7b8c9d"`
+@treturn[2] nil
+@treturn[2] string error message
+*/
+static int lua_uuid7(lua_State *L) {
+    return random_uuid(L, 7);
+}
+
+
+
+/***
+Generate a batch of uuids into a table.
+The random bytes for the batch are read from the OS at once.
+@function uuids
+@tparam int n the number of uuids
+@tparam[opt=4] int version the uuid version, 4 or 7
+@treturn[1] table the uuids (at indices 1 to n)
+@treturn[2] nil
+@treturn[2] string error message
+*/
+static int lua_uuids(lua_State *L) {
+    lua_Integer n = luaL_checkinteger(L, 1);
+    int version = (int)luaL_optinteger(L, 2, 4);
+    luaL_argcheck(L, n >= 0 && n < INT_MAX, 1, "invalid number of uuids");
+    luaL_argcheck(L, version == 4 || version == 7, 2, "version must be 4 or 7");
+    lua_settop(L, 2);
+    lua_createtable(L, (int)n, 0);
+
+    int batch = n < UUID_BATCH_SIZE ? (int)n : UUID_BATCH_SIZE;
+    unsigned char *buffer = (unsigned char *)lua_newuserdata(L, (size_t)batch * 16);
+    for (int i = 0; i < (int)n; i++) {
+        if (i % batch == 0) {
+            int count = (int)n - i < batch ? (int)n - i : batch;
+            if (!random_os_bytes(L, buffer, (size_t)count * 16)) {
+                return 2;
+            }
+        }
+        unsigned char *b = buffer + (i % batch) * 16;
+        random_uuid_set(b, version);
+        random_uuid_push(L, b);
+        lua_rawseti(L, 3, i + 1);
+    }
+
+    lua_settop(L, 3);
     return 1;
 }
 
@@ -126,6 +743,11 @@ static int lua_get_random_bytes(lua_State* L) {
 
 static luaL_Reg func[] = {
     { "random", lua_get_random_bytes },
+    { "randomints", lua_get_random_ints },
+    { "randompacked", lua_get_random_packed },
+    { "uuid4", lua_uuid4 },
+    { "uuid7", lua_uuid7 },
+    { "uuids", lua_uuids },
     { NULL, NULL }
 };
 
@@ -136,4 +758,15 @@ static luaL_Reg func[] = {
  *-------------------------------------------------------------------------*/
 void random_open(lua_State *L) {
     luaL_setfuncs(L, func, 0);
+
+    // the pool is an upvalue of 'fastrandom', allocated on first use
+    LS_RandomPoolRef *ref = (LS_RandomPoolRef *)lua_newuserdata(L, sizeof(LS_RandomPoolRef));
+    ref->pool = NULL;
+    ref->mapped = 0;
+    luaL_newmetatable(L, RANDOM_POOL_MT_NAME);
+    lua_pushcfunction(L, random_pool_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_setmetatable(L, -2);
+    lua_pushcclosure(L, lua_get_fastrandom_bytes, 1);
+    lua_setfield(L, -2, "fastrandom");
 }
@@ -0,0 +1,378 @@
+/// Random number generator module.
+// The rng object is a fast, seedable, pseudo random number generator, for
+// simulations, tests and load generation. It uses
+// [xoshiro256\*\*](https://prng.di.unimi.it/), implemented in C, so the same seed
+// gives the same sequence on every Lua version and platform (unlike `math.random`).
+//
+// It is NOT cryptographically secure, use `system.random` or `system.fastrandom` for that.
+//
+// See `system.rng` (the constructor) for an example.
+// @classmod rng
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <math.h>
+#include <string.h>
+#include "compat.h"
+#include "sysrandom.h"
+
+#define RNG_MT_NAME "LuaSystem.Rng"
+
+typedef struct {
+    uint64_t s[4];      // xoshiro256** state, never all zero
+    int has_spare;      // 'spare' holds the second normal variate of a pair
+    double spare;
+} LS_Rng;
+
+
+static uint64_t lsrng_rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t lsrng_next(LS_Rng *r) {
+    uint64_t *s = r->s;
+    uint64_t result = lsrng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = lsrng_rotl(s[3], 45);
+    return result;
+}
+
+// returns a double in [0, 1), with 53 random bits
+static double lsrng_double(LS_Rng *r) {
+    return (double)(lsrng_next(r) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// returns the high 64 bits of the 128-bit product, and the low bits in 'low'
+uint64_t rng_mul128(uint64_t a, uint64_t b, uint64_t *low) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = (unsigned __int128)a * b;
+    *low = (uint64_t)product;
+    return (uint64_t)(product >> 64);
+#else
+    uint64_t a_lo = a & 0xFFFFFFFF, a_hi = a >> 32;
+    uint64_t b_lo = b & 0xFFFFFFFF, b_hi = b >> 32;
+    uint64_t lo_lo = a_lo * b_lo;
+    uint64_t hi_lo = a_hi * b_lo;
+    uint64_t lo_hi = a_lo * b_hi;
+    uint64_t hi_hi = a_hi * b_hi;
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    *low = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+    return hi_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+// returns an unbiased value in [0, range), range > 0. Lemire's multiply-shift
+// reduction, which only needs a division when the first draw is near a boundary.
+static uint64_t lsrng_bounded(LS_Rng *r, uint64_t range) {
+    uint64_t low;
+    uint64_t result = rng_mul128(lsrng_next(r), range, &low);
+    if (low < range) {
+        uint64_t threshold = (0 - range) % range;
+        while (low < threshold) {
+            result = rng_mul128(lsrng_next(r), range, &low);
+        }
+    }
+    return result;
+}
+
+static void lsrng_seed(LS_Rng *r, uint64_t seed) {
+    // expand the seed with splitmix64, as recommended by the xoshiro authors
+    for (int i = 0; i < 4; i++) {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+        r->s[i] = z ^ (z >> 31);
+    }
+    r->has_spare = 0;
+}
+
+// Seeds from the argument at 'index', or from the OS if it is none/nil. On failure
+// it pushes nil and an error message, and returns 0.
+static int lsrng_seedarg(lua_State *L, LS_Rng *r, int index) {
+    if (lua_isnoneornil(L, index)) {
+        if (!random_os_bytes(L, (unsigned char *)r->s, sizeof(r->s))) {
+            return 0;
+        }
+        if ((r->s[0] | r->s[1] | r->s[2] | r->s[3]) == 0) r->s[0] = 1;
+        r->has_spare = 0;
+        return 1;
+    }
+
+#if LUA_VERSION_NUM >= 503
+    if (lua_isinteger(L, index)) {
+        lsrng_seed(r, (uint64_t)lua_tointeger(L, index));
+        return 1;
+    }
+#endif
+    lsrng_seed(r, (uint64_t)(int64_t)luaL_checknumber(L, index));
+    return 1;
+}
+
+static LS_Rng *lsrng_check(lua_State *L, int index) {
+    return (LS_Rng *)luaL_checkudata(L, index, RNG_MT_NAME);
+}
+
+// gets an integer argument; accepts floats, so also on Lua < 5.3
+static int64_t lsrng_checkint(lua_State *L, int index) {
+#if LUA_VERSION_NUM >= 503
+    if (lua_isinteger(L, index)) {
+        return (int64_t)lua_tointeger(L, index);
+    }
+#endif
+    return (int64_t)luaL_checknumber(L, index);
+}
+
+static LS_Rng *lsrng_push(lua_State *L) {
+    LS_Rng *r = (LS_Rng *)lua_newuserdata(L, sizeof(LS_Rng));
+    memset(r, 0, sizeof(LS_Rng));
+    luaL_getmetatable(L, RNG_MT_NAME);
+    lua_setmetatable(L, -2);
+    return r;
+}
+
+
+
+/***
+Creates a new random number generator.
+@function system.rng
+@tparam[opt] int seed the seed. If omitted, the generator is seeded from the OS (see `system.random`).
+Seeds are integers, on Lua versions before 5.3 they are limited to 2^53.
+@treturn[1] rng the new generator
+@treturn[2] nil
+@treturn[2] string error message
+@usage
+local sys = require 'system'
+local rng = sys.rng(42)  -- always the same sequence
+
+local dice = rng:int(1, 6)
+local delay = rng:exponential(1 / 0.2)  -- mean 0.2 seconds
+
+-- independent streams, e.g. one per worker
+local other = rng:clone()
+other:jump()
+*/
+static int lsrng_new(lua_State *L) {
+    LS_Rng *r = lsrng_push(L);
+    if (!lsrng_seedarg(L, r, 1)) {
+        return 2;
+    }
+    return 1;
+}
+
+/***
+Seeds the generator again.
+@function rng:seed
+@tparam[opt] int seed the seed. If omitted, the generator is seeded from the OS.
+@treturn[1] boolean `true`
+@treturn[2] nil
+@treturn[2] string error message
+*/
+static int lsrng_lua_seed(lua_State *L) {
+    LS_Rng *r = lsrng_check(L, 1);
+    if (!lsrng_seedarg(L, r, 2)) {
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+/***
+Returns a random integer.
+The range is reduced without bias (Lemire's method).
+Without arguments it returns a random 64-bit integer, on Lua versions before 5.3 a
+non-negative integer below 2^53 (a float).
+@function rng:int
+@tparam[opt] int lo the lower bound (inclusive), defaults to 1 if only `hi` is given
+@tparam[opt] int hi the upper bound (inclusive)
+@treturn int the random integer
+@usage
+local dice = rng:int(6)     -- 1 to 6
+local offset = rng:int(-10, 10)
+*/
+static int lsrng_lua_int(lua_State *L) {
+    LS_Rng *r = lsrng_check(L, 1);
+    int64_t lo, hi;
+
+    switch (lua_gettop(L)) {
+        case 1:
+#if LUA_VERSION_NUM >= 503
+            lua_pushinteger(L, (lua_Integer)lsrng_next(r));
+#else
+            lua_pushnumber(L, (lua_Number)(lsrng_next(r) >> 11));
+#endif
+            return 1;
+        case 2:
+            lo = 1;
+            hi = lsrng_checkint(L, 2);
+            break;
+        default:
+            lo = lsrng_checkint(L, 2);
+            hi = lsrng_checkint(L, 3);
+            break;
+    }
+    luaL_argcheck(L, lo <= hi, lua_gettop(L) == 2 ? 2 : 3, "interval is empty");
+
+    uint64_t range = (uint64_t)hi - (uint64_t)lo + 1;
+    uint64_t value = range == 0 ? lsrng_next(r) : lsrng_bounded(r, range);  // 0: full 64-bit range
+    ls_pushint64(L, (int64_t)((uint64_t)lo + value));
+    return 1;
+}
+
+/***
+Returns a random float in the range [0, 1).
+@function rng:float
+@treturn number the random float, with 53 random bits
+*/
+static int lsrng_lua_float(lua_State *L) {
+    lua_pushnumber(L, lsrng_double(lsrng_check(L, 1)));
+    return 1;
+}
+
+/***
+Returns random bytes.
+@function rng:bytes
+@tparam int n the number of bytes
+@treturn string the random bytes
+*/
+static int lsrng_lua_bytes(lua_State *L) {
+    LS_Rng *r = lsrng_check(L, 1);
+    lua_Integer n = luaL_checkinteger(L, 2);
+    luaL_argcheck(L, n >= 0, 2, "must not be negative");
+
+    luaL_Buffer b;
+    unsigned char *buffer = (unsigned char *)ls_buffinitsize(L, &b, (size_t)n);
+    for (lua_Integer i = 0; i < n; i += 8) {
+        // little endian, so the bytes are the same on every platform
+        uint64_t x = lsrng_next(r);
+        for (int j = 0; j < 8 && i + j < n; j++) {
+            buffer[i + j] = (unsigned char)(x >> (8 * j));
+        }
+    }
+    ls_pushresultsize(&b, (size_t)n);
+    return 1;
+}
+
+/***
+Returns a normally distributed random number.
+Uses the Marsaglia polar method.
+@function rng:normal
+@tparam[opt=0] number mean the mean
+@tparam[opt=1] number stddev the standard deviation
+@treturn number the random number
+*/
+static int lsrng_lua_normal(lua_State *L) {
+    LS_Rng *r = lsrng_check(L, 1);
+    lua_Number mean = luaL_optnumber(L, 2, 0.0);
+    lua_Number stddev = luaL_optnumber(L, 3, 1.0);
+    double z;
+
+    if (r->has_spare) {
+        r->has_spare = 0;
+        z = r->spare;
+    } else {
+        double u, v, s;
+        do {
+            u = 2.0 * lsrng_double(r) - 1.0;
+            v = 2.0 * lsrng_double(r) - 1.0;
+            s = u * u + v * v;
+        } while (s >= 1.0 || s == 0.0);
+        s = sqrt(-2.0 * log(s) / s);
+        r->spare = v * s;
+        r->has_spare = 1;
+        z = u * s;
+    }
+    lua_pushnumber(L, mean + stddev * z);
+    return 1;
+}
+
+/***
+Returns an exponentially distributed random number.
+@function rng:exponential
+@tparam[opt=1] number rate the rate (lambda), the mean is `1 / rate`
+@treturn number the random number
+*/
+static int lsrng_lua_exponential(lua_State *L) {
+    LS_Rng *r = lsrng_check(L, 1);
+    lua_Number rate = luaL_optnumber(L, 2, 1.0);
+    luaL_argcheck(L, rate > 0.0, 2, "rate must be greater than 0");
+    lua_pushnumber(L, -log(1.0 - lsrng_double(r)) / rate);
+    return 1;
+}
+
+/***
+Advances the generator by 2^128 steps.
+This is equivalent to 2^128 calls to `rng:int`, and can be used to create non-overlapping
+streams, by cloning a generator and jumping the clone (once for every stream).
+@function rng:jump
+*/
+static int lsrng_lua_jump(lua_State *L) {
+    static const uint64_t jump[] = {
+        0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c
+    };
+    LS_Rng *r = lsrng_check(L, 1);
+    uint64_t s[4] = { 0, 0, 0, 0 };
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (jump[i] & ((uint64_t)1 << b)) {
+                s[0] ^= r->s[0];
+                s[1] ^= r->s[1];
+                s[2] ^= r->s[2];
+                s[3] ^= r->s[3];
+            }
+            lsrng_next(r);
+        }
+    }
+    memcpy(r->s, s, sizeof(s));
+    r->has_spare = 0;
+    return 0;
+}
+
+/***
+Returns a copy of the generator, in the same state.
+@function rng:clone
+@treturn rng the copy
+*/
+static int lsrng_lua_clone(lua_State *L) {
+    LS_Rng *r = lsrng_check(L, 1);
+    LS_Rng *copy = lsrng_push(L);
+    *copy = *r;
+    return 1;
+}
+
+static int lsrng_tostring(lua_State *L) {
+    lua_pushfstring(L, "rng: %p", lsrng_check(L, 1));
+    return 1;
+}
+
+static const struct luaL_Reg lsrng_funcs[] = {
+    {"rng", lsrng_new},
+    {NULL, NULL}
+};
+
+static const struct luaL_Reg lsrng_methods[] = {
+    {"seed", lsrng_lua_seed},
+    {"int", lsrng_lua_int},
+    {"float", lsrng_lua_float},
+    {"bytes", lsrng_lua_bytes},
+    {"normal", lsrng_lua_normal},
+    {"exponential", lsrng_lua_exponential},
+    {"jump", lsrng_lua_jump},
+    {"clone", lsrng_lua_clone},
+    {"__tostring", lsrng_tostring},
+    {NULL, NULL}
+};
+
+void rng_open(lua_State *L) {
+    luaL_newmetatable(L, RNG_MT_NAME);
+    luaL_setfuncs(L, lsrng_methods, 0);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
+    luaL_setfuncs(L, lsrng_funcs, 0);
+}
@@ -0,0 +1,17 @@
+#ifndef LSSYSENV_H
+#define LSSYSENV_H
+
+// A copy of the environment, used when the shared environment is enabled (see
+// `sharedenv` in environment.c). It is never modified, only replaced.
+typedef struct {
+    volatile long refs;
+    char *entries[1];   // NULL terminated "name=value" strings, stored after the array
+} LS_EnvSnapshot;
+
+// Returns a reference to the current snapshot, or NULL if the shared environment is
+// not enabled. Does not lock. It must be released; a Lua error in between leaks it.
+LS_EnvSnapshot *env_snapshot_acquire(void);
+
+void env_snapshot_release(LS_EnvSnapshot *snapshot);
+
+#endif
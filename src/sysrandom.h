@@ -0,0 +1,16 @@
+#ifndef LSSYSRANDOM_H
+#define LSSYSRANDOM_H
+
+#include <lua.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Fills the buffer with random bytes from the OS. Returns 1 on success. On
+// failure it pushes nil and an error message, and returns 0.
+int random_os_bytes(lua_State *L, unsigned char *buffer, size_t num_bytes);
+
+
+// Returns the high 64 bits of the 128-bit product a * b, and the low bits in 'low'.
+uint64_t rng_mul128(uint64_t a, uint64_t b, uint64_t *low);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef LSSYSTIME_H
+#define LSSYSTIME_H
+
+#include <stdint.h>
+
+// Returns the system time in ns, relative to January 1, 1970 (UTC).
+int64_t time_gettime_ns(void);
+
+
+// Returns the monotonic time in ns, relative to an unspecified starting point.
+int64_t time_monotime_ns(void);
+
+#endif
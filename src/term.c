@@ -29,8 +29,11 @@
 # include <sys/ioctl.h>
 # include <unistd.h>
 # include <locale.h>
+# include <limits.h>
+# include <poll.h>
 #endif
 #include <wchar.h>
+#include "systime.h"
 
 
 // Windows does not have a wcwidth function, so we use compatibilty code from
@@ -867,21 +870,123 @@ static int utf8_buffer_len = 0;
 static int utf8_buffer_index = 0;
 #endif
 
+// Input read from stdin, but not returned yet. On Posix a read() takes all pending input
+// (up to the size), so a paste does not cost a syscall per byte. It is only refilled once
+// empty, so the bytes are always at the start, from 'term_inbuf_pos'. On Windows it only
+// holds input put back with `_unreadbytes`.
+#define TERM_INBUF_SIZE 4096
+static unsigned char term_inbuf[TERM_INBUF_SIZE];
+static size_t term_inbuf_pos = 0;
+static size_t term_inbuf_len = 0;
+
+// readansi keeps an incomplete sequence between calls, to complete it on the next call
+#define TERM_SEQ_MAX 256
+static char term_seq[TERM_SEQ_MAX];
+static size_t term_seq_len = 0;     // 0 if no sequence is in progress
+static int term_seq_utf8 = 0;       // the length of a UTF-8 sequence, or 0 for an ANSI sequence
+
+#define TERM_NO_DEADLINE INT64_MAX
+#define TERM_TIMEOUT -1     // no input available (yet)
+#define TERM_ERROR -2       // error, the results are pushed on the stack
+
+// Converts a timeout in seconds to a deadline on the monotonic clock (in ns), or 0
+// to not wait at all.
+static int64_t term_deadline(lua_Number timeout) {
+    if (timeout <= 0) return 0;
+    if (timeout >= 1.0e9) return TERM_NO_DEADLINE;
+    return time_monotime_ns() + (int64_t)(timeout * 1.0e9);
+}
+
+
+#ifndef _WIN32
+
+// Waits in poll() until stdin is readable, or the deadline (monotonic, in ns) passes.
+// Without 'fds' it just sleeps. Returns 1 if readable, 0 on timeout, -1 on error.
+static int term_poll_until(struct pollfd *fds, nfds_t nfds, int64_t deadline) {
+    for (;;) {
+        int ms = -1;
+        if (deadline != TERM_NO_DEADLINE) {
+            int64_t remaining = deadline - time_monotime_ns();
+            if (remaining < 0) remaining = 0;
+            remaining = (remaining + 999999) / 1000000;  // round up, to not return early
+            ms = remaining > INT_MAX ? INT_MAX : (int)remaining;
+        }
+        int r = poll(fds, nfds, ms);
+        if (r > 0) return 1;
+        if (r < 0 && errno != EINTR) return -1;
+        if (r == 0 && (deadline == TERM_NO_DEADLINE || time_monotime_ns() >= deadline)) return 0;
+        // interrupted, or poll returned early (at INT_MAX ms), retry for the remaining time
+    }
+}
+
+// Returns the next input byte, from the buffer or stdin, waiting until 'deadline' (0 to
+// not wait). Returns TERM_TIMEOUT if no input is available, or TERM_ERROR, with the error
+// pushed, and the number of values in 'results'.
+static int term_readbyte(lua_State *L, int64_t deadline, int *results) {
+    if (term_inbuf_len > 0) {
+        term_inbuf_len--;
+        return term_inbuf[term_inbuf_pos++];
+    }
+
+    // also without waiting, so read() does not block if stdin is in blocking mode
+    struct pollfd fd = { STDIN_FILENO, POLLIN, 0 };
+    int r = term_poll_until(&fd, 1, deadline);
+    if (r == 0) {
+        return TERM_TIMEOUT;
+    } else if (r < 0) {
+        *results = pusherror(L, "poll error");
+        return TERM_ERROR;
+    }
+
+    ssize_t bytes_read = read(STDIN_FILENO, term_inbuf, TERM_INBUF_SIZE);
+    if (bytes_read > 0) {
+        term_inbuf_pos = 1;
+        term_inbuf_len = (size_t)bytes_read - 1;
+        return term_inbuf[0];
+
+    } else if (bytes_read == 0) {
+        // End of file or stream closed; poll keeps reporting it as readable, so sleep
+        // until the deadline, like when no key is pressed, instead of spinning
+        if (deadline != 0) {
+            term_poll_until(NULL, 0, deadline);
+        }
+        return TERM_TIMEOUT;
+
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        // Resource temporarily unavailable, no data available to read
+        return TERM_TIMEOUT;
+    }
+    *results = pusherror(L, "read error");
+    return TERM_ERROR;
+}
+#endif
+
 
 /***
-Reads a key from the console non-blocking. This function should not be called
+Reads a key from the console. This function should not be called
 directly, but through the `system.readkey` or `system.readansi` functions. It
 will return the next byte from the input stream, or `nil` if no key was pressed.
 
-On Posix, `io.stdin` must be set to non-blocking mode using `setnonblock`
-and canonical mode must be turned off using `tcsetattr`,
-before calling this function. Otherwise it will block. No conversions are
-done on Posix, so the byte read is returned as-is.
+On Posix, canonical mode should be turned off using `tcsetattr` before calling this
+function, otherwise input only becomes available after a newline. It does not block: it
+checks for input using `poll()` (with a timeout of 0 if no `timeout` is given), and only
+reads when input is available. No conversions are done on Posix, so the byte read is
+returned as-is.
+
+On Posix, with a `timeout`, it waits in `poll()` until input is available or the timeout
+expires, so a key is returned as soon as it is pressed. On Windows the `timeout` is
+ignored, it does not wait.
+
+On Posix all pending input is read at once, into an internal 4 KiB buffer; the following
+calls return bytes from the buffer, until it is empty. Hence mixing this function with other
+ways of reading `stdin` (eg. `io.stdin:read`) is unsafe, they will miss the buffered input.
+Use `readbytes` to get the pending input instead.
 
 On Windows this reads a wide character and converts it to UTF-8. Multi-byte
 sequences will be buffered internally and returned one byte at a time.
 
 @function _readkey
+@tparam[opt=0] number timeout the time in seconds to wait for input (`math.huge` waits forever)
 @treturn[1] integer the byte read from the input stream
 @treturn[2] nil if no key was pressed
 @treturn[3] nil on error
@@ -891,6 +996,13 @@ sequences will be buffered internally and returned one byte at a time.
 */
 static int lst_readkey(lua_State *L) {
 #ifdef _WIN32
+    if (term_inbuf_len > 0) {
+        // input put back with _unreadbytes
+        lua_pushinteger(L, term_inbuf[term_inbuf_pos++]);
+        term_inbuf_len--;
+        return 1;
+    }
+
     if (utf8_buffer_len > 0) {
         // Buffer not empty, return the next byte
         lua_pushinteger(L, (unsigned char)utf8_buffer[utf8_buffer_index]);
@@ -982,25 +1094,282 @@ static int lst_readkey(lua_State *L) {
 
 #else
     // Posix implementation
-    char ch;
-    ssize_t bytes_read = read(STDIN_FILENO, &ch, 1);
-    if (bytes_read > 0) {
-        lua_pushinteger(L, (unsigned char)ch);
+    int results;
+    int key = term_readbyte(L, term_deadline(luaL_optnumber(L, 1, 0)), &results);
+    if (key >= 0) {
+        lua_pushinteger(L, key);
         return 1;
+    }
+    return key == TERM_ERROR ? results : 0;
 
-    } else if (bytes_read == 0) {
-        return 0;  // End of file or stream closed
+#endif
+}
 
-    } else {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            // Resource temporarily unavailable, no data available to read
-            return 0;
-        } else {
-            return pusherror(L, "read error");
+
+
+/***
+Reads all pending input from the console, without waiting.
+This returns the input as a single string, instead of a byte at a time, so a large paste
+is read in a few calls. It includes the input buffered by `_readkey`.
+
+The same preparations as for `_readkey` apply. On Windows the keys are read one by one
+(and converted to UTF-8), as with `_readkey`.
+@function readbytes
+@tparam[opt] int max the maximum number of bytes to return, default no limit
+@treturn[1] string the input
+@treturn[2] nil if no input is pending
+@treturn[3] nil on error
+@treturn[3] string error message
+@treturn[3] int errnum (on posix)
+@within Terminal_Input
+*/
+static int lst_readbytes(lua_State *L) {
+    size_t max = (size_t)-1;
+    if (!lua_isnoneornil(L, 1)) {
+        lua_Integer n = luaL_checkinteger(L, 1);
+        luaL_argcheck(L, n > 0, 1, "must be greater than 0");
+        max = (size_t)n;
+    }
+    lua_settop(L, 0);
+
+#ifdef _WIN32
+    // collect the bytes from _readkey in a chunk, and concatenate the chunks on the stack
+    char chunk[256];
+    size_t n = 0;
+    size_t total = 0;
+    int pieces = 0;
+    while (total < max) {
+        int results = lst_readkey(L);
+        if (results != 1) {
+            if (results > 1 && total == 0) {
+                return results;  // the error
+            }
+            lua_pop(L, results);
+            break;
+        }
+        chunk[n++] = (char)lua_tointeger(L, -1);
+        lua_pop(L, 1);
+        total++;
+        if (n == sizeof(chunk)) {
+            lua_pushlstring(L, chunk, n);
+            if (++pieces == 2) {
+                lua_concat(L, 2);
+                pieces = 1;
+            }
+            n = 0;
+        }
+    }
+    if (total == 0) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_pushlstring(L, chunk, n);
+    lua_concat(L, pieces + 1);
+    return 1;
+
+#else
+    luaL_Buffer b;
+    luaL_buffinit(L, &b);
+
+    // first the input buffered by _readkey
+    size_t total = term_inbuf_len < max ? term_inbuf_len : max;
+    luaL_addlstring(&b, (const char *)term_inbuf + term_inbuf_pos, total);
+    term_inbuf_pos += total;
+    term_inbuf_len -= total;
+
+    // then read directly into the result, while input is pending
+    struct pollfd fd = { STDIN_FILENO, POLLIN, 0 };
+    while (total < max && poll(&fd, 1, 0) > 0) {
+        size_t size = max - total < LUAL_BUFFERSIZE ? max - total : LUAL_BUFFERSIZE;
+        ssize_t bytes_read = read(STDIN_FILENO, luaL_prepbuffer(&b), size);
+        if (bytes_read < 0) {
+            if (total == 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                return pusherror(L, "read error");
+            }
+            break;
         }
+        luaL_addsize(&b, (size_t)bytes_read);
+        total += (size_t)bytes_read;
+        if ((size_t)bytes_read < size) {
+            break;  // drained (or end of file)
+        }
+    }
+
+    if (total == 0) {
+        lua_pushnil(L);
+        return 1;
     }
+    luaL_pushresult(&b);
+    return 1;
+#endif
+}
 
+
+
+/***
+Puts bytes back in front of the input.
+They are returned first by `_readkey`, `_readansi` and `readbytes`, before any new input.
+This can be used to return input that was read, but not used. It is also useful for testing,
+with `discard` the input is reset to exactly `bytes`, without reading from `stdin`.
+@function _unreadbytes
+@tparam string bytes the bytes to put back
+@tparam[opt=false] boolean discard if truthy, first drops the buffered input, and any
+incomplete sequence kept by `_readansi`
+@within Terminal_Input
+*/
+static int lst_unreadbytes(lua_State *L) {
+    size_t len;
+    const char *bytes = luaL_checklstring(L, 1, &len);
+    if (lua_toboolean(L, 2)) {
+        term_inbuf_len = 0;
+        term_seq_len = 0;
+#ifdef _WIN32
+        utf8_buffer_len = 0;
 #endif
+    }
+    luaL_argcheck(L, len <= TERM_INBUF_SIZE - term_inbuf_len, 1, "does not fit in the input buffer");
+    memmove(term_inbuf + len, term_inbuf + term_inbuf_pos, term_inbuf_len);
+    memcpy(term_inbuf, bytes, len);
+    term_inbuf_pos = 0;
+    term_inbuf_len += len;
+    return 0;
+}
+
+
+
+#ifdef _WIN32
+// Returns the next input byte, see the Posix version. Windows does not wait for input,
+// the deadline is ignored.
+static int term_readbyte(lua_State *L, int64_t deadline, int *results) {
+    (void)deadline;
+    int r = lst_readkey(L);
+    if (r == 1) {
+        int key = (int)lua_tointeger(L, -1);
+        lua_pop(L, 1);
+        return key;
+    } else if (r > 1) {
+        *results = r;
+        return TERM_ERROR;
+    }
+    return TERM_TIMEOUT;
+}
+#endif
+
+
+// the last byte of an ANSI sequence
+static int term_isansiend(int key) {
+    return (key >= 'A' && key <= 'Z') || (key >= 'a' && key <= '~');
+}
+
+// pushes the sequence and its type, and clears it
+static int term_pushseq(lua_State *L, const char *type) {
+    lua_pushlstring(L, term_seq, term_seq_len);
+    lua_pushstring(L, type);
+    term_seq_len = 0;
+    return 2;
+}
+
+
+/***
+Reads a single key, or a complete ANSI sequence, from the console. This function should
+not be called directly, but through `system.readansi`, see there for the details and
+return values. It parses the input in C, as a resumable state machine; an incomplete
+sequence is kept, and completed on the next call.
+
+On Posix it waits in `poll()` until the timeout expires. On Windows it does not wait.
+@function _readansi
+@tparam number timeout the time in seconds to wait for input
+@within Terminal_Input
+*/
+static int lst_readansi(lua_State *L) {
+    lua_Number timeout = luaL_checknumber(L, 1);
+    lua_settop(L, 0);
+    int results;
+    int key;
+
+    if (term_seq_len == 0) {
+        // no sequence in progress, read a key
+        key = term_readbyte(L, term_deadline(timeout), &results);
+        if (key == TERM_TIMEOUT) {
+            lua_pushnil(L);
+            lua_pushliteral(L, "timeout");
+            return 2;
+        } else if (key == TERM_ERROR) {
+            lua_settop(L, 2);  // nil, error message
+            return 2;
+        }
+        term_seq[term_seq_len++] = (char)key;
+
+        if (key == 27) {
+            // looks like an ansi escape sequence, immediately read the next byte
+            // as a heuristic against manually typing escape sequences
+            int key2 = term_readbyte(L, 0, &results);
+            if (key2 < 0) {
+                // no key available, return the escape key on its own
+                lua_settop(L, 0);
+                return term_pushseq(L, "ctrl");
+            }
+            term_seq[term_seq_len++] = (char)key2;
+
+            if (key2 == '[') {
+                // "[" means it is for sure an ANSI sequence
+            } else if (key2 == 'O') {
+                // "O" means it is either an ANSI sequence or just an <alt>+O key stroke
+                int key3 = term_readbyte(L, 0, &results);
+                if (key3 < 0) {
+                    // no key available, return the <alt>O key stroke, report as ANSI
+                    lua_settop(L, 0);
+                    return term_pushseq(L, "ansi");
+                }
+                term_seq[term_seq_len++] = (char)key3;
+                if (term_isansiend(key3)) {
+                    return term_pushseq(L, "ansi");
+                }
+            } else {
+                // not an ANSI sequence, but an <alt>+<key2> key stroke, so report as ANSI
+                return term_pushseq(L, "ansi");
+            }
+            term_seq_utf8 = 0;
+
+        } else {
+            // check the UTF-8 length; bytes from 248 are handled as an ANSI sequence
+            term_seq_utf8 = key < 128 ? 1 : key < 224 ? 2 : key < 240 ? 3 : key < 248 ? 4 : 0;
+            if (term_seq_utf8 == 1) {
+                return term_pushseq(L, (key <= 31 || key == 127) ? "ctrl" : "char");
+            }
+        }
+    }
+
+    // read the remainder of the sequence
+    int64_t deadline = term_deadline(timeout);
+    for (;;) {
+        key = term_readbyte(L, deadline, &results);
+        if (key < 0) {
+            break;
+        }
+        term_seq[term_seq_len++] = (char)key;
+
+        if (term_seq_utf8 != 0 ? term_seq_len == (size_t)term_seq_utf8 : term_isansiend(key)) {
+            return term_pushseq(L, term_seq_utf8 != 0 ? "char" : "ansi");
+        }
+        if (term_seq_len == TERM_SEQ_MAX) {
+            lua_pushnil(L);
+            lua_pushliteral(L, "sequence too long");
+            lua_pushlstring(L, term_seq, term_seq_len);
+            term_seq_len = 0;
+            return 3;
+        }
+    }
+
+    // error, or timeout reached, return the sequence so far
+    if (key == TERM_ERROR) {
+        lua_settop(L, 2);  // nil, error message
+    } else {
+        lua_pushnil(L);
+        lua_pushliteral(L, "timeout");
+    }
+    lua_pushlstring(L, term_seq, term_seq_len);
+    return 3;
 }
 
 
@@ -1313,6 +1682,9 @@ static luaL_Reg func[] = {
     { "getnonblock", lst_getnonblock },
     { "setnonblock", lst_setnonblock },
     { "_readkey", lst_readkey },
+    { "readbytes", lst_readbytes },
+    { "_unreadbytes", lst_unreadbytes },
+    { "_readansi", lst_readansi },
     { "termsize", lst_termsize },
     { "utf8cwidth", lst_utf8cwidth },
     { "utf8swidth", lst_utf8swidth },
@@ -3,9 +3,17 @@
 /// Time.
 // @section time
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE  // for RUSAGE_THREAD
+#endif
+
 #include <lua.h>
 #include <lauxlib.h>
 #include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
 
 #ifdef _WIN32
 #include <float.h>
@@ -13,6 +21,26 @@
 #else
 #include <time.h>
 #include <sys/time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#include <sys/timerfd.h>
+#include <sys/prctl.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define HAVE_TSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#include <cpuid.h>
+#endif
+#elif defined(__aarch64__) && defined(__GNUC__)
+#define HAVE_CNTVCT 1
 #endif
 
 #ifdef __APPLE__
@@ -34,6 +62,7 @@
 #endif
 
 #include "compat.h"
+#include "systime.h"
 
 /*-------------------------------------------------------------------------
  * Gets time in s, relative to January 1, 1970 (UTC)
@@ -78,6 +107,275 @@ static double time_monotime(void) {
 
 
 
+/*-------------------------------------------------------------------------
+ * Gets time in ns, relative to January 1, 1970 (UTC)
+ * Returns
+ *   time in ns.
+ *-------------------------------------------------------------------------*/
+#ifdef _WIN32
+int64_t time_gettime_ns(void) {
+    FILETIME ft;
+    ULARGE_INTEGER t;
+    GetSystemTimeAsFileTime(&ft);
+    t.LowPart = ft.dwLowDateTime;
+    t.HighPart = ft.dwHighDateTime;
+    /* Windows file time is in 100ns units, since January 1, 1601 (UTC) */
+    return ((int64_t)t.QuadPart - INT64_C(116444736000000000)) * 100;
+}
+#else
+int64_t time_gettime_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
+
+
+
+/*-------------------------------------------------------------------------
+ * Gets monotonic time in ns, relative to an unspecified starting point
+ * Returns
+ *   time in ns.
+ *-------------------------------------------------------------------------*/
+#ifdef _WIN32
+int64_t time_monotime_ns(void) {
+    static LARGE_INTEGER freq = { 0 };
+    LARGE_INTEGER count;
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    /* split to prevent overflow of count * 1e9 */
+    return (count.QuadPart / freq.QuadPart) * 1000000000 +
+           (count.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart;
+}
+#else
+int64_t time_monotime_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
+
+
+
+/*-------------------------------------------------------------------------
+ * Sleeps until a deadline on the time_monotime_ns() clock. On Posix it
+ * uses an absolute sleep, retried to the same deadline when interrupted.
+ * Returns
+ *   0 on success, or an error number on failure.
+ *-------------------------------------------------------------------------*/
+#ifdef _WIN32
+static int time_sleep_until_ns(int64_t deadline) {
+    int64_t n;
+    if (timeBeginPeriod(1) != TIMERR_NOERROR) return -1;
+    while ((n = deadline - time_monotime_ns()) > 0) {
+        n = (n + 999999) / 1000000;  /* round up to ms */
+        if (n > INT_MAX) n = INT_MAX;
+        Sleep((DWORD)n);
+    }
+    timeEndPeriod(1);
+    return 0;
+}
+#else
+static int time_sleep_until_ns(int64_t deadline) {
+    struct timespec t;
+    if (deadline <= 0) return 0;
+#if defined(TIMER_ABSTIME) && !defined(__APPLE__)
+    int r;
+    t.tv_sec = (time_t) (deadline / 1000000000);
+    t.tv_nsec = (long) (deadline % 1000000000);
+    while ((r = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL)) == EINTR);
+    return r;
+#else
+    // no absolute sleep available (MacOS), recalculate the remaining time
+    // from the deadline on every iteration, so errors do not accumulate
+    int64_t n;
+    while ((n = deadline - time_monotime_ns()) > 0) {
+        t.tv_sec = (time_t) (n / 1000000000);
+        t.tv_nsec = (long) (n % 1000000000);
+        nanosleep(&t, NULL);
+    }
+    return 0;
+#endif
+}
+#endif
+
+
+
+/*-------------------------------------------------------------------------
+ * Clock ids for the selectable clocks. Clocks not available on the
+ * platform are exported as -1.
+ *-------------------------------------------------------------------------*/
+#ifdef _WIN32
+// Windows has no clock ids, so define the ones we emulate
+#ifndef CLOCK_REALTIME
+#define CLOCK_REALTIME 0
+#endif
+#ifndef CLOCK_MONOTONIC
+#define CLOCK_MONOTONIC 1
+#endif
+#ifndef CLOCK_PROCESS_CPUTIME_ID
+#define CLOCK_PROCESS_CPUTIME_ID 2
+#endif
+#ifndef CLOCK_THREAD_CPUTIME_ID
+#define CLOCK_THREAD_CPUTIME_ID 3
+#endif
+#endif
+
+typedef struct ls_ClockConst {
+    const char *name;
+    int value;
+} ls_ClockConst;
+
+static const ls_ClockConst clock_ids[] = {
+    {"CLOCK_REALTIME", CLOCK_REALTIME},
+    {"CLOCK_MONOTONIC", CLOCK_MONOTONIC},
+#ifdef CLOCK_MONOTONIC_RAW
+    {"CLOCK_MONOTONIC_RAW", CLOCK_MONOTONIC_RAW},
+#else
+    {"CLOCK_MONOTONIC_RAW", -1},
+#endif
+#ifdef CLOCK_MONOTONIC_COARSE
+    {"CLOCK_MONOTONIC_COARSE", CLOCK_MONOTONIC_COARSE},
+#else
+    {"CLOCK_MONOTONIC_COARSE", -1},
+#endif
+#ifdef CLOCK_REALTIME_COARSE
+    {"CLOCK_REALTIME_COARSE", CLOCK_REALTIME_COARSE},
+#else
+    {"CLOCK_REALTIME_COARSE", -1},
+#endif
+#ifdef CLOCK_BOOTTIME
+    {"CLOCK_BOOTTIME", CLOCK_BOOTTIME},
+#else
+    {"CLOCK_BOOTTIME", -1},
+#endif
+#ifdef CLOCK_PROCESS_CPUTIME_ID
+    {"CLOCK_PROCESS_CPUTIME_ID", CLOCK_PROCESS_CPUTIME_ID},
+#else
+    {"CLOCK_PROCESS_CPUTIME_ID", -1},
+#endif
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    {"CLOCK_THREAD_CPUTIME_ID", CLOCK_THREAD_CPUTIME_ID},
+#else
+    {"CLOCK_THREAD_CPUTIME_ID", -1},
+#endif
+    {NULL, 0}
+};
+
+
+
+/*-------------------------------------------------------------------------
+ * Reads a clock by id, and its resolution.
+ * Returns
+ *   0 on success, -1 on failure. On failure the error message is set.
+ *-------------------------------------------------------------------------*/
+#ifdef _WIN32
+static int64_t time_filetime_ns(const FILETIME *ft) {
+    ULARGE_INTEGER t;
+    t.LowPart = ft->dwLowDateTime;
+    t.HighPart = ft->dwHighDateTime;
+    return (int64_t)t.QuadPart * 100;
+}
+
+static int time_clock_ns(int id, int64_t *ns, const char **err) {
+    FILETIME creation, exit, kernel, user;
+    switch (id) {
+    case CLOCK_REALTIME:
+        *ns = time_gettime_ns();
+        return 0;
+    case CLOCK_MONOTONIC:
+        *ns = time_monotime_ns();
+        return 0;
+    case CLOCK_PROCESS_CPUTIME_ID:
+        if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) break;
+        *ns = time_filetime_ns(&kernel) + time_filetime_ns(&user);
+        return 0;
+    case CLOCK_THREAD_CPUTIME_ID:
+        if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) break;
+        *ns = time_filetime_ns(&kernel) + time_filetime_ns(&user);
+        return 0;
+    default:
+        *err = "clock not supported";
+        return -1;
+    }
+    *err = "failed to read clock";
+    return -1;
+}
+
+static int time_clockres_ns(int id, int64_t *ns, const char **err) {
+    DWORD adjustment, increment;
+    BOOL disabled;
+    LARGE_INTEGER freq;
+    switch (id) {
+    case CLOCK_MONOTONIC:
+        QueryPerformanceFrequency(&freq);
+        *ns = (1000000000 + freq.QuadPart - 1) / freq.QuadPart;
+        return 0;
+    case CLOCK_REALTIME:
+    case CLOCK_PROCESS_CPUTIME_ID:
+    case CLOCK_THREAD_CPUTIME_ID:
+        // these are updated on the system clock tick
+        if (!GetSystemTimeAdjustment(&adjustment, &increment, &disabled)) break;
+        *ns = (int64_t)increment * 100;
+        return 0;
+    default:
+        *err = "clock not supported";
+        return -1;
+    }
+    *err = "failed to read clock resolution";
+    return -1;
+}
+#else
+static int time_clock_ns(int id, int64_t *ns, const char **err) {
+    struct timespec ts;
+    if (id < 0) {
+        *err = "clock not supported";
+        return -1;
+    }
+    if (clock_gettime(id, &ts) != 0) {
+        *err = strerror(errno);
+        return -1;
+    }
+    *ns = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    return 0;
+}
+
+static int time_clockres_ns(int id, int64_t *ns, const char **err) {
+    struct timespec ts;
+    if (id < 0) {
+        *err = "clock not supported";
+        return -1;
+    }
+    if (clock_getres(id, &ts) != 0) {
+        *err = strerror(errno);
+        return -1;
+    }
+    *ns = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    return 0;
+}
+#endif
+
+
+
+/*-------------------------------------------------------------------------
+ * Pushes a nanosecond time as 2 integers; seconds and nanoseconds.
+ * Returns
+ *   2, the number of results pushed.
+ *-------------------------------------------------------------------------*/
+static int time_pushtimespec(lua_State *L, int64_t ns) {
+    int64_t sec = ns / 1000000000;
+    int64_t nsec = ns % 1000000000;
+    if (nsec < 0) {
+        sec--;
+        nsec += 1000000000;
+    }
+    ls_pushint64(L, sec);
+    lua_pushinteger(L, (lua_Integer)nsec);
+    return 2;
+}
+
+
+
 /***
 Get system time.
 The time is returned as the seconds since the epoch (1 January 1970 00:00:00).
@@ -106,6 +404,183 @@ static int time_lua_monotime(lua_State *L)
 
 
 
+/***
+Get system time in nanoseconds.
+The time is returned as the nanoseconds since the epoch (1 January 1970 00:00:00).
+
+__NOTE__: on Lua versions without 64-bit integers (Lua 5.1, 5.2 and LuaJIT) the
+result is a float, which cannot hold the full precision. Use `gettimespec` there.
+@function gettime_ns
+@treturn integer nanoseconds
+*/
+static int time_lua_gettime_ns(lua_State *L)
+{
+    ls_pushint64(L, time_gettime_ns());
+    return 1;
+}
+
+
+
+/***
+Get monotonic time in nanoseconds.
+The time is returned as the nanoseconds since an unspecified starting point
+(typically system start). Only differences between values are meaningful.
+
+__NOTE__: on Lua versions without 64-bit integers (Lua 5.1, 5.2 and LuaJIT) the
+result is a float, which cannot hold the full precision. Use `monotimespec` there.
+@function monotime_ns
+@treturn integer nanoseconds
+*/
+static int time_lua_monotime_ns(lua_State *L)
+{
+    ls_pushint64(L, time_monotime_ns());
+    return 1;
+}
+
+
+
+/***
+Get system time as seconds and nanoseconds.
+Same as `gettime_ns`, but split in 2 values that are exact on every Lua version.
+@function gettimespec
+@treturn integer seconds since the epoch (1 January 1970 00:00:00)
+@treturn integer nanoseconds (0 to 999999999)
+*/
+static int time_lua_gettimespec(lua_State *L)
+{
+    return time_pushtimespec(L, time_gettime_ns());
+}
+
+
+
+/***
+Get monotonic time as seconds and nanoseconds.
+Same as `monotime_ns`, but split in 2 values that are exact on every Lua version.
+@function monotimespec
+@treturn integer seconds since an unspecified starting point
+@treturn integer nanoseconds (0 to 999999999)
+*/
+static int time_lua_monotimespec(lua_State *L)
+{
+    return time_pushtimespec(L, time_monotime_ns());
+}
+
+
+
+/***
+Get the time of a specific clock.
+The clock ids are available as constants on the module table:
+
+- `CLOCK_REALTIME` system time, since the epoch (same as `gettime`)
+- `CLOCK_MONOTONIC` monotonic time (same as `monotime`)
+- `CLOCK_MONOTONIC_RAW` monotonic time, not subject to NTP adjustments
+- `CLOCK_MONOTONIC_COARSE` faster, but less precise version of `CLOCK_MONOTONIC`
+- `CLOCK_REALTIME_COARSE` faster, but less precise version of `CLOCK_REALTIME`
+- `CLOCK_BOOTTIME` monotonic time, that includes time spent in suspend
+- `CLOCK_PROCESS_CPUTIME_ID` CPU time consumed by the process
+- `CLOCK_THREAD_CPUTIME_ID` CPU time consumed by the calling thread
+
+Clocks not available on a platform have the value `-1`. On Windows only
+`CLOCK_REALTIME`, `CLOCK_MONOTONIC`, and the CPU time clocks are available.
+@function clock
+@tparam integer id the clock id, eg. `system.CLOCK_MONOTONIC_RAW`
+@treturn[1] number seconds (fractional)
+@treturn[2] nil
+@treturn[2] string error message
+@usage
+local system = require('system')
+local t0 = system.clock(system.CLOCK_PROCESS_CPUTIME_ID)
+-- do some work
+print("CPU time used: ", system.clock(system.CLOCK_PROCESS_CPUTIME_ID) - t0)
+*/
+static int time_lua_clock(lua_State *L)
+{
+    int64_t ns;
+    const char *err;
+    if (time_clock_ns((int)luaL_checkinteger(L, 1), &ns, &err) != 0) {
+        lua_pushnil(L);
+        lua_pushstring(L, err);
+        return 2;
+    }
+    lua_pushnumber(L, ns*1.0e-9);
+    return 1;
+}
+
+
+
+/***
+Get the time of a specific clock in nanoseconds.
+See `clock` for the available clocks, and `gettime_ns` for the precision
+caveat on Lua versions without 64-bit integers.
+@function clock_ns
+@tparam integer id the clock id, eg. `system.CLOCK_MONOTONIC_RAW`
+@treturn[1] integer nanoseconds
+@treturn[2] nil
+@treturn[2] string error message
+*/
+static int time_lua_clock_ns(lua_State *L)
+{
+    int64_t ns;
+    const char *err;
+    if (time_clock_ns((int)luaL_checkinteger(L, 1), &ns, &err) != 0) {
+        lua_pushnil(L);
+        lua_pushstring(L, err);
+        return 2;
+    }
+    ls_pushint64(L, ns);
+    return 1;
+}
+
+
+
+/***
+Get the time of a specific clock as seconds and nanoseconds.
+See `clock` for the available clocks.
+@function clockspec
+@tparam integer id the clock id, eg. `system.CLOCK_MONOTONIC_RAW`
+@treturn[1] integer seconds
+@treturn[1] integer nanoseconds (0 to 999999999)
+@treturn[2] nil
+@treturn[2] string error message
+*/
+static int time_lua_clockspec(lua_State *L)
+{
+    int64_t ns;
+    const char *err;
+    if (time_clock_ns((int)luaL_checkinteger(L, 1), &ns, &err) != 0) {
+        lua_pushnil(L);
+        lua_pushstring(L, err);
+        return 2;
+    }
+    return time_pushtimespec(L, ns);
+}
+
+
+
+/***
+Get the resolution of a specific clock.
+See `clock` for the available clocks.
+@function clockres
+@tparam integer id the clock id, eg. `system.CLOCK_MONOTONIC_COARSE`
+@treturn[1] number resolution in seconds (fractional)
+@treturn[2] nil
+@treturn[2] string error message
+*/
+static int time_lua_clockres(lua_State *L)
+{
+    int64_t ns;
+    const char *err;
+    if (time_clockres_ns((int)luaL_checkinteger(L, 1), &ns, &err) != 0) {
+        lua_pushnil(L);
+        lua_pushstring(L, err);
+        return 2;
+    }
+    lua_pushnumber(L, ns*1.0e-9);
+    return 1;
+}
+
+
+
 /***
 Sleep without a busy loop.
 This function will sleep, without doing a busy-loop and wasting CPU cycles.
@@ -157,10 +632,842 @@ static int time_lua_sleep(lua_State *L)
 }
 #endif
 
+/***
+Sleep until an absolute deadline, without a busy loop.
+The deadline is a point in time on the `monotime` clock. Since the deadline is absolute,
+interruptions and the time spent between calls do not accumulate, which makes this
+suitable for fixed-rate loops that should not drift.
+On Posix it uses `clock_nanosleep` with `TIMER_ABSTIME` where available, and is retried
+until the deadline on interruption (`EINTR`).
+@function sleep_until
+@tparam number deadline the `monotime` value to sleep until (fractional). Returns immediately if in the past.
+@tparam[opt=16] integer precision minimum stepsize in milliseconds (Windows only, ignored elsewhere)
+@return `true` on success, or `nil+err` on failure
+@usage
+local system = require('system')
+local interval = 0.001  -- 1 kHz
+local deadline = system.monotime()
+while true do
+  deadline = deadline + interval
+  system.sleep_until(deadline)
+  -- do the periodic work
+end
+*/
+#ifdef _WIN32
+static int time_lua_sleep_until(lua_State *L)
+{
+    double deadline = luaL_checknumber(L, 1);
+
+    int precision = luaL_optinteger(L, 2, 16);
+    if (precision < 0 || precision > 16) precision = 16;
+
+    if (deadline > 0.0) {
+        if (deadline > INT_MAX) deadline = INT_MAX;
+        int64_t deadline_ns = (int64_t) (deadline * 1.0e9);
+        int64_t n;
+        if (deadline_ns <= time_monotime_ns()) {
+            lua_pushboolean(L, 1);
+            return 1;
+        }
+        if (timeBeginPeriod(precision) != TIMERR_NOERROR) {
+            lua_pushnil(L);
+            lua_pushstring(L, "failed to set timer precision");
+            return 2;
+        };
+        // Sleep may wake up early (by up to a timer tick), so check the deadline again,
+        // like the Posix version does
+        while ((n = deadline_ns - time_monotime_ns()) > 0) {
+            n = (n + 999999) / 1000000;  /* round up to ms */
+            if (n > INT_MAX) n = INT_MAX;
+            Sleep((DWORD)n);
+        }
+        timeEndPeriod(precision);
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+#else
+static int time_lua_sleep_until(lua_State *L)
+{
+    double deadline = luaL_checknumber(L, 1);
+    if (deadline > 0.0) {
+        if (deadline > INT_MAX) deadline = INT_MAX;
+        int r = time_sleep_until_ns((int64_t) (deadline * 1.0e9));
+        if (r != 0) {
+            lua_pushnil(L);
+            lua_pushfstring(L, "clock_nanosleep() failed: %s", strerror(r));
+            return 2;
+        }
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+#endif
+
+
+
+/***
+Sleep with high precision.
+The OS sleep functions typically overshoot the requested time, due to timer slack
+and scheduling latency (tens of microseconds on Linux, milliseconds on Windows). This
+function sleeps until `margin` seconds before the deadline, and then busy-loops on the
+monotonic clock until the deadline is reached. So it trades CPU time for accuracy.
+
+See also `settimerslack` to reduce the overshoot of the regular sleep functions on Linux.
+@function sleep_precise
+@tparam number seconds seconds to sleep (fractional).
+@tparam[opt] number margin the part of the time (in seconds, fractional) at the end to spin instead
+of sleep. Defaults to 0.0002 (200 microseconds), and 0.002 on Windows.
+@return `true` on success, or `nil+err` on failure
+*/
+static int time_lua_sleep_precise(lua_State *L)
+{
+    double n = luaL_checknumber(L, 1);
+#ifdef _WIN32
+    double margin = luaL_optnumber(L, 2, 0.002);
+#else
+    double margin = luaL_optnumber(L, 2, 0.0002);
+#endif
+    if (margin < 0.0) margin = 0.0;
+
+    if (n > 0.0) {
+        if (n > INT_MAX) n = INT_MAX;
+        int64_t deadline = time_monotime_ns() + (int64_t) (n * 1.0e9);
+        if (n > margin) {
+            int r = time_sleep_until_ns(deadline - (int64_t) (margin * 1.0e9));
+            if (r != 0) {
+                lua_pushnil(L);
+                lua_pushstring(L, "failed to sleep");
+                return 2;
+            }
+        }
+        while (time_monotime_ns() < deadline);
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+
+
+/***
+Sets the timer slack of the current thread (Linux).
+The kernel groups timer expirations that are close together, to reduce wakeups. The slack is how
+much a sleep may overshoot for this purpose, the default is 50 microseconds. Reducing
+it improves the accuracy of sleeps, at the cost of more wakeups.
+
+On other platforms this is a no-op.
+@function settimerslack
+@tparam integer ns the timer slack in nanoseconds, 0 restores the default.
+@treturn[1] boolean `true` on success (always `true` on non-Linux systems)
+@treturn[2] nil
+@treturn[2] string error message
+*/
+static int time_lua_settimerslack(lua_State *L)
+{
+    lua_Integer ns = luaL_checkinteger(L, 1);
+    luaL_argcheck(L, ns >= 0, 1, "timer slack must not be negative");
+#ifdef __linux__
+    if (prctl(PR_SET_TIMERSLACK, (unsigned long)ns, 0, 0, 0) != 0) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "failed to set timer slack: %s", strerror(errno));
+        return 2;
+    }
+#endif
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+
+
+/***
+Gets the timer slack of the current thread (Linux).
+See `settimerslack`.
+@function gettimerslack
+@treturn[1] integer the timer slack in nanoseconds (always 0 on non-Linux systems)
+@treturn[2] nil
+@treturn[2] string error message
+*/
+static int time_lua_gettimerslack(lua_State *L)
+{
+#ifdef __linux__
+    int slack = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+    if (slack < 0) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "failed to get timer slack: %s", strerror(errno));
+        return 2;
+    }
+    lua_pushinteger(L, slack);
+#else
+    lua_pushinteger(L, 0);
+#endif
+    return 1;
+}
+
+
+
+/*-------------------------------------------------------------------------
+ * CPU cycle counter
+ *-------------------------------------------------------------------------*/
+
+#define CYCLES_CLOCK 0      // fallback to time_monotime_ns()
+#define CYCLES_TSC 1        // x86 timestamp counter, only if invariant
+#define CYCLES_CNTVCT 2     // aarch64 virtual counter
+
+static int cycles_source = CYCLES_CLOCK;
+static double cycles_per_ns = 0.0;  // 0.0 means not calibrated yet
+
+// selects the counter to use, called once on module load
+static void time_cycles_init(void) {
+#if defined(HAVE_TSC)
+    // the TSC is only usable if it is invariant; CPUID leaf 0x80000007, EDX bit 8
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0x80000000);
+    if ((unsigned int)regs[0] >= 0x80000007) {
+        __cpuid(regs, 0x80000007);
+        if (regs[3] & (1 << 8)) cycles_source = CYCLES_TSC;
+    }
+#else
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8))) {
+        cycles_source = CYCLES_TSC;
+    }
+#endif
+#elif defined(HAVE_CNTVCT)
+    // the counter frequency is known, so no calibration required
+    uint64_t freq;
+    __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(freq));
+    if (freq > 0) {
+        cycles_source = CYCLES_CNTVCT;
+        cycles_per_ns = freq * 1.0e-9;
+    }
+#endif
+    if (cycles_source == CYCLES_CLOCK) cycles_per_ns = 1.0;
+}
+
+static uint64_t time_cycles(void) {
+#if defined(HAVE_TSC)
+    if (cycles_source == CYCLES_TSC) return __rdtsc();
+#elif defined(HAVE_CNTVCT)
+    if (cycles_source == CYCLES_CNTVCT) {
+        uint64_t count;
+        __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(count));
+        return count;
+    }
+#endif
+    return (uint64_t)time_monotime_ns();
+}
+
+// one-time calibration of the counter against time_monotime_ns()
+static double time_cycles_calibrate(void) {
+    if (cycles_per_ns == 0.0) {
+        int64_t t0 = time_monotime_ns();
+        uint64_t c0 = time_cycles();
+        time_sleep_until_ns(t0 + 20000000);  // 20ms
+        int64_t t1 = time_monotime_ns();
+        uint64_t c1 = time_cycles();
+        cycles_per_ns = (double)(c1 - c0) / (double)(t1 - t0);
+    }
+    return cycles_per_ns;
+}
+
+
+
+/***
+Get the CPU cycle counter.
+Reads the timestamp counter (`rdtsc`) on x86, or the virtual counter (`cntvct_el0`) on aarch64.
+This is cheaper than reading a clock, so suitable for timing very short pieces of code.
+The value has no meaning by itself, use `cycles_ns` to convert the difference between 2 values
+to nanoseconds.
+
+If the counter is unavailable, or not invariant (it would change frequency with the CPU), the
+monotonic clock is used, in nanoseconds. See `cyclesrate` for the source used.
+
+__NOTE__: on Lua versions without 64-bit integers (Lua 5.1, 5.2 and LuaJIT) the
+result is a float, which can lose precision on systems with a long uptime.
+@function cycles
+@treturn integer the counter value
+@usage
+local system = require('system')
+local c0 = system.cycles()
+-- do some work
+print("took: ", system.cycles_ns(system.cycles() - c0), "ns")
+*/
+static int time_lua_cycles(lua_State *L)
+{
+    ls_pushint64(L, (int64_t)time_cycles());
+    return 1;
+}
+
+
+
+/***
+Get the rate of the CPU cycle counter.
+The first call calibrates the counter against the monotonic clock, which takes about 20ms.
+@function cyclesrate
+@treturn number counter ticks per nanosecond
+@treturn string the source of the counter; `"tsc"`, `"cntvct"`, or `"clock"` (the fallback)
+*/
+static int time_lua_cyclesrate(lua_State *L)
+{
+    lua_pushnumber(L, time_cycles_calibrate());
+    switch (cycles_source) {
+    case CYCLES_TSC:
+        lua_pushliteral(L, "tsc");
+        break;
+    case CYCLES_CNTVCT:
+        lua_pushliteral(L, "cntvct");
+        break;
+    default:
+        lua_pushliteral(L, "clock");
+    }
+    return 2;
+}
+
+
+
+/***
+Converts a number of CPU cycles to nanoseconds.
+The first call calibrates the counter, see `cyclesrate`.
+@function cycles_ns
+@tparam number cycles the number of cycles, the difference between 2 `cycles` results
+@treturn number nanoseconds (fractional)
+*/
+static int time_lua_cycles_ns(lua_State *L)
+{
+    lua_Number cycles = luaL_checknumber(L, 1);
+    lua_pushnumber(L, cycles / time_cycles_calibrate());
+    return 1;
+}
+
+
+
+/*-------------------------------------------------------------------------
+ * Resource usage
+ *-------------------------------------------------------------------------*/
+
+typedef struct {
+    int64_t utime;      // user CPU time in ns
+    int64_t stime;      // system CPU time in ns
+    int64_t maxrss;     // maximum resident set size in bytes
+    int64_t minflt;     // minor page faults
+    int64_t majflt;     // major page faults
+    int64_t nvcsw;      // voluntary context switches
+    int64_t nivcsw;     // involuntary context switches
+} LS_RUsage;
+
+static const char *const rusage_who[] = { "self", "children", "thread", NULL };
+
+// fills the usage struct, who is the index in rusage_who.
+// Returns NULL on success, or an error message.
+#ifdef _WIN32
+static const char *time_rusage(int who, LS_RUsage *usage) {
+    FILETIME creation, exit, kernel, user;
+    memset(usage, 0, sizeof(LS_RUsage));
+    if (who == 0) {
+        if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+            return "failed to get process times";
+        }
+    } else if (who == 2) {
+        if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+            return "failed to get thread times";
+        }
+    } else {
+        return "not supported";
+    }
+    usage->utime = time_filetime_ns(&user);
+    usage->stime = time_filetime_ns(&kernel);
+    return NULL;
+}
+#else
+static const char *time_rusage(int who, LS_RUsage *usage) {
+    struct rusage ru;
+    int rwho;
+    memset(usage, 0, sizeof(LS_RUsage));
+    switch (who) {
+    case 0:
+        rwho = RUSAGE_SELF;
+        break;
+    case 1:
+        rwho = RUSAGE_CHILDREN;
+        break;
+    default:
+#ifdef RUSAGE_THREAD
+        rwho = RUSAGE_THREAD;
+        break;
+#else
+        return "not supported";
+#endif
+    }
+    if (getrusage(rwho, &ru) != 0) {
+        return "failed to get resource usage";
+    }
+    usage->utime = (int64_t)ru.ru_utime.tv_sec * 1000000000 + (int64_t)ru.ru_utime.tv_usec * 1000;
+    usage->stime = (int64_t)ru.ru_stime.tv_sec * 1000000000 + (int64_t)ru.ru_stime.tv_usec * 1000;
+#ifdef __APPLE__
+    usage->maxrss = ru.ru_maxrss;  // MacOS reports bytes
+#else
+    usage->maxrss = (int64_t)ru.ru_maxrss * 1024;  // others report kilobytes
+#endif
+    usage->minflt = ru.ru_minflt;
+    usage->majflt = ru.ru_majflt;
+    usage->nvcsw = ru.ru_nvcsw;
+    usage->nivcsw = ru.ru_nivcsw;
+    return NULL;
+}
+#endif
+
+static void time_setintfield(lua_State *L, const char *name, int64_t value) {
+    ls_pushint64(L, value);
+    lua_setfield(L, -2, name);
+}
+
+
+
+/***
+Get resource usage.
+Returns the CPU time used, and other resource usage statistics, of the process, its
+(terminated and waited-for) children, or the calling thread. To prevent allocating a new table
+on every call, a table can be passed in to be filled.
+
+The result table has the following fields:
+
+- `utime` user CPU time in nanoseconds
+- `stime` system CPU time in nanoseconds
+- `maxrss` maximum resident set size in bytes
+- `minflt` minor page faults (no I/O required)
+- `majflt` major page faults (I/O required)
+- `nvcsw` voluntary context switches (eg. waiting for I/O)
+- `nivcsw` involuntary context switches (eg. time slice expired)
+
+On Windows only the CPU times are available (the other fields are 0), and `"children"` is not supported.
+`"thread"` is only supported on Linux, FreeBSD, and Windows.
+@function rusage
+@tparam[opt="self"] string who one of `"self"`, `"children"`, or `"thread"`.
+@tparam[opt] table tbl the table to fill, a new one is created if omitted.
+@treturn[1] table the table with resource usage (same as `tbl` if given)
+@treturn[2] nil
+@treturn[2] string error message
+@usage
+local system = require('system')
+local usage = {}
+system.rusage("self", usage)
+local cpu = usage.utime + usage.stime
+-- do some work
+system.rusage("self", usage)
+print("CPU time used (ns): ", usage.utime + usage.stime - cpu)
+*/
+static int time_lua_rusage(lua_State *L)
+{
+    LS_RUsage usage;
+    int who = luaL_checkoption(L, 1, "self", rusage_who);
+    const char *err = time_rusage(who, &usage);
+    if (err != NULL) {
+        lua_pushnil(L);
+        lua_pushstring(L, err);
+        return 2;
+    }
+
+    if (lua_isnoneornil(L, 2)) {
+        lua_createtable(L, 0, 7);
+    } else {
+        luaL_checktype(L, 2, LUA_TTABLE);
+        lua_settop(L, 2);
+    }
+    time_setintfield(L, "utime", usage.utime);
+    time_setintfield(L, "stime", usage.stime);
+    time_setintfield(L, "maxrss", usage.maxrss);
+    time_setintfield(L, "minflt", usage.minflt);
+    time_setintfield(L, "majflt", usage.majflt);
+    time_setintfield(L, "nvcsw", usage.nvcsw);
+    time_setintfield(L, "nivcsw", usage.nivcsw);
+    return 1;
+}
+
+
+
+/*-------------------------------------------------------------------------
+ * Timestamp formatting
+ *-------------------------------------------------------------------------*/
+
+// the formatted parts for a single second, so repeated calls within the
+// same second only need to format the fraction. Keyed on the second only, so a
+// time zone change is picked up once another second is formatted.
+// The buffers fit any 'int' tm fields (11 chars) and 'long' offsets (20 chars), so
+// snprintf cannot truncate, even though the actual values are much shorter.
+typedef struct {
+    int64_t sec;            // the second cached
+    int valid;
+    char extended[72];      // "YYYY-MM-DDTHH:MM:SS"
+    char basic[72];         // "YYYYMMDDTHHMMSS"
+    char extended_off[48];  // "+hh:mm" or "Z"
+    char basic_off[48];     // "+hhmm" or "Z"
+} LS_TimeCache;
+
+static LS_THREAD_LOCAL LS_TimeCache time_cache[2];  // [0] local time, [1] UTC
+
+static const char *const formattime_presets[] = {
+    "rfc3339", "rfc3339ms", "rfc3339us", "rfc3339ns",
+    "iso8601", "iso8601ms", "iso8601us", "iso8601ns",
+    NULL
+};
+
+// returns the offset of local time to UTC in seconds
+static long time_utcoffset(const struct tm *lt, const struct tm *gt) {
+    long days = lt->tm_yday - gt->tm_yday;
+    if (lt->tm_year != gt->tm_year) days = (lt->tm_year > gt->tm_year) ? 1 : -1;
+    return days * 86400L + (lt->tm_hour - gt->tm_hour) * 3600L +
+           (lt->tm_min - gt->tm_min) * 60L + (lt->tm_sec - gt->tm_sec);
+}
+
+// fills the cache for the given second. Returns 0 on success, -1 on failure.
+static int time_fillcache(LS_TimeCache *cache, int64_t sec, int utc) {
+    time_t t = (time_t)sec;
+    struct tm tm, gm;
+#ifdef _WIN32
+    if ((utc ? gmtime_s(&tm, &t) : localtime_s(&tm, &t)) != 0) return -1;
+    if (!utc && gmtime_s(&gm, &t) != 0) return -1;
+#else
+    if ((utc ? gmtime_r(&t, &tm) : localtime_r(&t, &tm)) == NULL) return -1;
+    if (!utc && gmtime_r(&t, &gm) == NULL) return -1;
+#endif
+    snprintf(cache->extended, sizeof(cache->extended), "%04d-%02d-%02dT%02d:%02d:%02d",
+             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    snprintf(cache->basic, sizeof(cache->basic), "%04d%02d%02dT%02d%02d%02d",
+             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    if (utc) {
+        strcpy(cache->extended_off, "Z");
+        strcpy(cache->basic_off, "Z");
+    } else {
+        long offset = time_utcoffset(&tm, &gm);
+        char sign = offset < 0 ? '-' : '+';
+        if (offset < 0) offset = -offset;
+        snprintf(cache->extended_off, sizeof(cache->extended_off), "%c%02ld:%02ld",
+                 sign, offset / 3600, (offset % 3600) / 60);
+        snprintf(cache->basic_off, sizeof(cache->basic_off), "%c%02ld%02ld",
+                 sign, offset / 3600, (offset % 3600) / 60);
+    }
+    cache->sec = sec;
+    cache->valid = 1;
+    return 0;
+}
+
+
+
+/***
+Formats a timestamp.
+Formats the time as a string, for example for log lines. The date, time and UTC offset of the
+last second formatted are cached, so formatting multiple timestamps within the same second
+only formats the fraction. Hence a change of the time zone (eg. setting `TZ`) only takes
+effect once a timestamp in another second is formatted.
+
+The available formats are:
+
+- `"rfc3339"`: `2024-03-15T14:30:45+01:00`
+- `"rfc3339ms"`: `2024-03-15T14:30:45.123+01:00`
+- `"rfc3339us"`: `2024-03-15T14:30:45.123456+01:00`
+- `"rfc3339ns"`: `2024-03-15T14:30:45.123456789+01:00`
+- `"iso8601"`: `20240315T143045+0100` (ISO-8601 basic format)
+- `"iso8601ms"`: `20240315T143045.123+0100`
+- `"iso8601us"`: `20240315T143045.123456+0100`
+- `"iso8601ns"`: `20240315T143045.123456789+0100`
+
+In UTC the offset is replaced by `Z`.
+@function formattime
+@tparam[opt] number t the time in seconds since the epoch (fractional), as returned by `gettime`.
+Defaults to the current time (with nanosecond precision, which a float argument cannot hold).
+@tparam[opt="rfc3339ms"] string fmt the format to use, see above.
+@tparam[opt=false] boolean utc if truthy, formats the time in UTC, otherwise in local time.
+@treturn[1] string the formatted time
+@treturn[2] nil
+@treturn[2] string error message
+@usage
+local system = require('system')
+print(system.formattime())                            -- 2024-03-15T14:30:45.123+01:00
+print(system.formattime(nil, "rfc3339us", true))      -- 2024-03-15T13:30:45.123456Z
+print(system.formattime(system.gettime(), "iso8601")) -- 20240315T143045+0100
+*/
+static int time_lua_formattime(lua_State *L)
+{
+    int64_t ns;
+    if (lua_isnoneornil(L, 1)) {
+        ns = time_gettime_ns();
+    } else {
+        lua_Number t = luaL_checknumber(L, 1);
+        luaL_argcheck(L, t > -9.0e9 && t < 9.0e9, 1, "time out of range");
+        // t * 1e9 would be truncated one unit low (.25 as .249999...). A double near the
+        // epoch only holds about 7 decimals, so round the fraction to microseconds; eg.
+        // 1700000000.123 is stored as 1700000000.1229999065.
+        lua_Number whole = floor(t);
+        int64_t us = (int64_t)floor((t - whole) * 1.0e6 + 0.5);  // the subtraction is exact
+        int64_t sec = (int64_t)whole;
+        if (us >= 1000000) {
+            sec++;
+            us -= 1000000;
+        }
+        ns = sec * 1000000000 + us * 1000;
+    }
+    int fmt = luaL_checkoption(L, 2, "rfc3339ms", formattime_presets);
+    int utc = lua_toboolean(L, 3) ? 1 : 0;
+    int basic = fmt / 4;
+    int digits = (fmt % 4) * 3;
+
+    int64_t sec = ns / 1000000000;
+    int64_t frac = ns % 1000000000;
+    if (frac < 0) {
+        sec--;
+        frac += 1000000000;
+    }
+
+    LS_TimeCache *cache = &time_cache[utc];
+    if (!cache->valid || cache->sec != sec) {
+        if (time_fillcache(cache, sec, utc) != 0) {
+            cache->valid = 0;
+            lua_pushnil(L);
+            lua_pushliteral(L, "failed to convert time");
+            return 2;
+        }
+    }
+
+    char buf[sizeof(cache->extended) + 16 + sizeof(cache->extended_off)];
+    char fraction[16] = "";
+    if (digits == 3) {
+        snprintf(fraction, sizeof(fraction), ".%03d", (int)(frac / 1000000));
+    } else if (digits == 6) {
+        snprintf(fraction, sizeof(fraction), ".%06d", (int)(frac / 1000));
+    } else if (digits == 9) {
+        snprintf(fraction, sizeof(fraction), ".%09d", (int)frac);
+    }
+    int len = snprintf(buf, sizeof(buf), "%s%s%s",
+                       basic ? cache->basic : cache->extended,
+                       fraction,
+                       basic ? cache->basic_off : cache->extended_off);
+    lua_pushlstring(L, buf, len);
+    return 1;
+}
+
+
+
+/*-------------------------------------------------------------------------
+ * Periodic timer
+ *-------------------------------------------------------------------------*/
+
+#define TIMER_MT_NAME "LuaSystem.Timer"
+
+typedef struct {
+    int64_t interval;   // interval in ns
+    int64_t next;       // next expiration on the time_monotime_ns() clock (no timerfd)
+    int fd;             // the timerfd, or -1 if not available
+    int closed;
+} LS_Timer;
+
+static LS_Timer *time_checktimer(lua_State *L, int index) {
+    LS_Timer *timer = (LS_Timer *)luaL_checkudata(L, index, TIMER_MT_NAME);
+    if (timer->closed) luaL_argerror(L, index, "timer is closed");
+    return timer;
+}
+
+static void time_closetimer(LS_Timer *timer) {
+#ifdef __linux__
+    if (timer->fd >= 0) close(timer->fd);
+#endif
+    timer->fd = -1;
+    timer->closed = 1;
+}
+
+
+
+/***
+Creates a periodic timer.
+The timer expires every `interval` seconds, the first expiration being after `delay` seconds.
+Use `timer:wait` to block until the next expiration. Since the timer keeps ticking independent
+of the time spent between the calls to `wait`, the tick rate does not drift.
+
+On Linux the timer is backed by a `timerfd`, elsewhere the expirations are tracked on the
+`monotime` clock.
+@function timer
+@tparam number interval the interval in seconds (fractional), must be greater than 0
+@tparam[opt=interval] number delay the delay before the first expiration in seconds (fractional)
+@treturn[1] timer the timer object
+@treturn[2] nil
+@treturn[2] string error message
+@usage
+local system = require('system')
+local timer = assert(system.timer(1/60))  -- 60 fps
+while true do
+  local missed = assert(timer:wait())
+  if missed > 0 then
+    print("frames dropped: ", missed)
+  end
+  -- render the frame
+end
+*/
+static int time_lua_timer(lua_State *L)
+{
+    double interval = luaL_checknumber(L, 1);
+    double delay = luaL_optnumber(L, 2, interval);
+    luaL_argcheck(L, interval > 0.0 && interval < INT_MAX, 1, "interval must be greater than 0");
+    luaL_argcheck(L, delay >= 0.0 && delay < INT_MAX, 2, "delay must not be negative");
+
+    LS_Timer *timer = (LS_Timer *)lua_newuserdata(L, sizeof(LS_Timer));
+    timer->interval = (int64_t) (interval * 1.0e9);
+    if (timer->interval < 1) timer->interval = 1;
+    timer->next = time_monotime_ns() + (int64_t) (delay * 1.0e9);
+    timer->fd = -1;
+    timer->closed = 0;
+    luaL_getmetatable(L, TIMER_MT_NAME);
+    lua_setmetatable(L, -2);
+
+#ifdef __linux__
+    struct itimerspec its;
+    int64_t first = (int64_t) (delay * 1.0e9);
+    if (first < 1) first = 1;  // a zero value would disarm the timer
+    its.it_interval.tv_sec = (time_t) (timer->interval / 1000000000);
+    its.it_interval.tv_nsec = (long) (timer->interval % 1000000000);
+    its.it_value.tv_sec = (time_t) (first / 1000000000);
+    its.it_value.tv_nsec = (long) (first % 1000000000);
+
+    timer->fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timer->fd < 0) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "timerfd_create() failed: %s", strerror(errno));
+        return 2;
+    }
+    if (timerfd_settime(timer->fd, 0, &its, NULL) != 0) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "timerfd_settime() failed: %s", strerror(errno));
+        time_closetimer(timer);
+        return 2;
+    }
+#endif
+    return 1;
+}
+
+
+
+/***
+Waits for the next timer expiration.
+Blocks until the timer expires. If one or more expirations passed since the last call,
+it returns immediately.
+@function timer:wait
+@treturn[1] integer the number of expirations that were missed since the last call (0 if on time)
+@treturn[2] nil
+@treturn[2] string error message
+*/
+static int time_lua_timer_wait(lua_State *L)
+{
+    LS_Timer *timer = time_checktimer(L, 1);
+    int64_t missed;
+#ifdef __linux__
+    uint64_t expirations;
+    ssize_t n;
+    while ((n = read(timer->fd, &expirations, sizeof(expirations))) < 0 && errno == EINTR);
+    if (n != sizeof(expirations)) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "failed reading timer: %s", n < 0 ? strerror(errno) : "short read");
+        return 2;
+    }
+    missed = (int64_t)expirations - 1;
+#else
+    int64_t now;
+    if (time_sleep_until_ns(timer->next) != 0) {
+        lua_pushnil(L);
+        lua_pushstring(L, "failed waiting for timer");
+        return 2;
+    }
+    now = time_monotime_ns();
+    missed = (now - timer->next) / timer->interval;
+    timer->next += (missed + 1) * timer->interval;
+#endif
+    ls_pushint64(L, missed);
+    return 1;
+}
+
+
+
+/***
+Returns the file descriptor of the timer (Linux).
+The descriptor becomes readable when the timer expires, so it can be multiplexed with other
+descriptors (eg. stdin) using `poll` or `select`. After it becomes readable, call `timer:wait`
+to consume the expirations.
+@function timer:fd
+@treturn[1] integer the file descriptor
+@treturn[2] nil if the timer is not backed by a file descriptor (non-Linux)
+*/
+static int time_lua_timer_fd(lua_State *L)
+{
+    LS_Timer *timer = time_checktimer(L, 1);
+    if (timer->fd < 0) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_pushinteger(L, timer->fd);
+    return 1;
+}
+
+
+
+/***
+Closes the timer.
+Releases the resources, the timer can no longer be used afterwards. This will be
+done automatically when the timer is garbage collected.
+@function timer:close
+@treturn boolean `true`
+*/
+static int time_lua_timer_close(lua_State *L)
+{
+    time_closetimer(time_checktimer(L, 1));
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int time_lua_timer_gc(lua_State *L)
+{
+    LS_Timer *timer = (LS_Timer *)luaL_checkudata(L, 1, TIMER_MT_NAME);
+    if (!timer->closed) time_closetimer(timer);
+    return 0;
+}
+
+static int time_lua_timer_tostring(lua_State *L)
+{
+    LS_Timer *timer = (LS_Timer *)luaL_checkudata(L, 1, TIMER_MT_NAME);
+    lua_pushfstring(L, "timer: %p%s", (void *)timer, timer->closed ? " (closed)" : "");
+    return 1;
+}
+
+static luaL_Reg timer_methods[] = {
+    { "wait", time_lua_timer_wait },
+    { "fd", time_lua_timer_fd },
+    { "close", time_lua_timer_close },
+    { "__gc", time_lua_timer_gc },
+    { "__tostring", time_lua_timer_tostring },
+    { NULL, NULL }
+};
+
+
+
 static luaL_Reg func[] = {
     { "gettime", time_lua_gettime },
     { "monotime", time_lua_monotime },
+    { "gettime_ns", time_lua_gettime_ns },
+    { "monotime_ns", time_lua_monotime_ns },
+    { "gettimespec", time_lua_gettimespec },
+    { "monotimespec", time_lua_monotimespec },
+    { "clock", time_lua_clock },
+    { "clock_ns", time_lua_clock_ns },
+    { "clockspec", time_lua_clockspec },
+    { "clockres", time_lua_clockres },
     { "sleep", time_lua_sleep },
+    { "sleep_until", time_lua_sleep_until },
+    { "sleep_precise", time_lua_sleep_precise },
+    { "settimerslack", time_lua_settimerslack },
+    { "gettimerslack", time_lua_gettimerslack },
+    { "timer", time_lua_timer },
+    { "cycles", time_lua_cycles },
+    { "cyclesrate", time_lua_cyclesrate },
+    { "cycles_ns", time_lua_cycles_ns },
+    { "rusage", time_lua_rusage },
+    { "formattime", time_lua_formattime },
     { NULL, NULL }
 };
 
@@ -168,5 +1475,18 @@ static luaL_Reg func[] = {
  * Initializes module
  *-------------------------------------------------------------------------*/
 void time_open(lua_State *L) {
+    time_cycles_init();
+
+    luaL_newmetatable(L, TIMER_MT_NAME);
+    luaL_setfuncs(L, timer_methods, 0);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
+    for (int i = 0; clock_ids[i].name != NULL; i++)
+    {
+        lua_pushinteger(L, clock_ids[i].value);
+        lua_setfield(L, -2, clock_ids[i].name);
+    }
     luaL_setfuncs(L, func, 0);
 }
@@ -63,4 +63,23 @@ static int clock_gettime(int clockid, struct timespec *ts) {
     } /* switch() */
 } /* clock_gettime() */
 
+static int clock_getres(int clockid, struct timespec *ts) {
+    switch (clockid) {
+    case CLOCK_REALTIME:
+        ts->tv_sec = 0;
+        ts->tv_nsec = 1000;  /* gettimeofday() has microsecond resolution */
+
+        return 0;
+    case CLOCK_MONOTONIC:
+        ts->tv_sec = 0;
+        ts->tv_nsec = (clock_timebase.numer + clock_timebase.denom - 1) / clock_timebase.denom;
+
+        return 0;
+    default:
+        errno = EINVAL;
+
+        return -1;
+    } /* switch() */
+} /* clock_getres() */
+
 #endif /* TIME_OSX_H */
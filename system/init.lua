@@ -238,14 +238,19 @@ end
 
 do
   --- Reads a single byte from the console, with a timeout.
-  -- This function uses `fsleep` to wait until either a byte is available or the timeout is reached.
-  -- The sleep period is exponentially backing off, starting at 0.0125 seconds, with a maximum of 0.1 seconds.
+  -- On Posix, without `fsleep`, it waits in `poll()` until either a byte is available or the
+  -- timeout is reached, so a key is returned as soon as it is pressed.
+  --
+  -- With `fsleep` (eg. for a coroutine scheduler), or on Windows, this function uses `fsleep` to
+  -- wait. The sleep period is exponentially backing off, starting at 0.0125 seconds, with a maximum
+  -- of 0.1 seconds.
   -- It returns immediately if a byte is available or if `timeout` is less than or equal to `0`.
   --
   -- Using `system.readansi` is preferred over this function. Since this function can leave stray/invalid
   -- byte-sequences in the input buffer, while `system.readansi` reads full ANSI and UTF8 sequences.
   -- @tparam number timeout the timeout in seconds.
-  -- @tparam[opt=system.sleep] function fsleep the function to call for sleeping; `ok, err = fsleep(secs)`
+  -- @tparam[opt] function fsleep the function to call for sleeping; `ok, err = fsleep(secs)`,
+  -- defaults to `system.sleep` on Windows.
   -- @treturn[1] byte the byte value that was read.
   -- @treturn[2] nil if no key was read
   -- @treturn[2] string error message when the timeout was reached (`"timeout"`), or if `sleep` failed.
@@ -255,6 +260,15 @@ do
       error("arg #1 to readkey, expected timeout in seconds, got " .. type(timeout), 2)
     end
 
+    if not fsleep and not system.windows then
+      -- wait in C, for the exact timeout
+      local key, err = system._readkey(timeout)
+      if key or err then
+        return key, err
+      end
+      return nil, "timeout"
+    end
+
     local interval = 0.0125
     local ok
     local key, err = system._readkey()
@@ -281,18 +295,14 @@ end
 
 
 do
-  local sequence -- table to store the sequence in progress
-  local utf8_length -- length of utf8 sequence currently being processed
-  local unpack = unpack or table.unpack
-
   --- Reads a single key, if it is the start of ansi escape sequence then it reads
   -- the full sequence. The key can be a multi-byte string in case of multibyte UTF-8 character.
-  -- This function uses `system.readkey`, and hence `fsleep` to wait until either a key is
-  -- available or the timeout is reached.
+  -- The input is parsed in C (see `system._readansi`). Like `system.readkey`, it uses `poll()` or
+  -- `fsleep` to wait until either a key is available or the timeout is reached.
   -- It returns immediately if a key is available or if `timeout` is less than or equal to `0`.
   -- In case of an ANSI sequence, it will return the full sequence as a string.
   -- @tparam number timeout the timeout in seconds.
-  -- @tparam[opt=system.sleep] function fsleep the function to call for sleeping.
+  -- @tparam[opt] function fsleep the function to call for sleeping, see `system.readkey`.
   -- @treturn[1] string the character that was received (can be multi-byte), or a complete ANSI sequence
   -- @treturn[1] string the type of input: `"ctrl"` for 0-31 and 127 bytes, `"char"` for other UTF-8 characters, `"ansi"` for an ANSI sequence
   -- @treturn[2] nil in case of an error
@@ -312,109 +322,25 @@ do
     if type(timeout) ~= "number" then
       error("arg #1 to readansi, expected timeout in seconds, got " .. type(timeout), 2)
     end
-    fsleep = fsleep or system.sleep
-
-    local key
-
-    if not sequence then
-      -- no sequence in progress, read a key
-      local err
-      key, err = system.readkey(timeout, fsleep)
-      if key == nil then -- timeout or error
-        return nil, err
-      end
-
-      if key == 27 then
-        -- looks like an ansi escape sequence, immediately read next char
-        -- as an heuristic against manually typing escape sequences
-        local key2 = system.readkey(0, fsleep)
-        if key2 == nil then
-          -- no key available, return the escape key, on its own
-          sequence = nil
-          return string.char(key), "ctrl"
-
-        elseif key2 == 91 then
-          -- "[" means it is for sure an ANSI sequence
-          sequence = { key, key2 }
-
-        elseif key2 == 79 then
-          -- "O" means it is either an ANSI sequence or just an <alt>+O key stroke
-          -- check if there is yet another byte available
-          local key3 = system.readkey(0, fsleep)
-          if key3 == nil then
-            -- no key available, return the <alt>O key stroke, report as ANSI
-            sequence = nil
-            return string.char(key, key2), "ansi"
-          end
-          -- it's an ANSI sequence, marked with <ESC>O
-          if (key3 >= 65 and key3 <= 90) or (key3 >= 97 and key3 <= 126) then
-            -- end of sequence, return the full sequence
-            return string.char(key, key2, key3), "ansi"
-          end
-          sequence = { key, key2, key3 }
-
-        else
-          -- not an ANSI sequence, but an <alt>+<key2> key stroke, so report as ANSI
-          sequence = nil
-          return string.char(key, key2), "ansi"
-        end
 
-      else
-        -- check UTF8 length
-        utf8_length = key < 128 and 1 or key < 224 and 2 or key < 240 and 3 or key < 248 and 4
-        if utf8_length == 1 then
-          -- single byte character
-          utf8_length = nil
-          return string.char(key), ((key <= 31 or key == 127) and "ctrl" or "char")
-        else
-          -- UTF8 sequence detected
-          sequence = { key }
-        end
-      end
+    if not fsleep and not system.windows then
+      -- wait in C, for the exact timeout
+      return system._readansi(timeout)
     end
 
-    local err
-    if utf8_length then
-      -- read remainder of UTF8 sequence
-      local timeout_end = system.gettime() + timeout
-      while true do
-        key, err = system.readkey(timeout_end - system.gettime(), fsleep)
-        if err then
-          break
-        end
-        table.insert(sequence, key)
-
-        if #sequence == utf8_length then
-          -- end of sequence, return the full sequence
-          local result = string.char(unpack(sequence))
-          sequence = nil
-          utf8_length = nil
-          return result, "char"
-        end
-      end
-
-    else
-      -- read remainder of ANSI sequence
-      local timeout_end = system.gettime() + timeout
-      while true do
-        key, err = system.readkey(timeout_end - system.gettime(), fsleep)
-        if err then
-          break
-        end
-        table.insert(sequence, key)
-
-        if (key >= 65 and key <= 90) or (key >= 97 and key <= 126) then
-          -- end of sequence, return the full sequence
-          local result = string.char(unpack(sequence))
-          sequence = nil
-          return result, "ansi"
-        end
+    local interval = 0.0125
+    local ok
+    local key, err, partial = system._readansi(0)
+    while key == nil and err == "timeout" and timeout > 0 do
+      ok, err = (fsleep or system.sleep)(math.min(interval, timeout))
+      if not ok then
+        return nil, err, partial
       end
+      timeout = timeout - interval
+      interval = math.min(0.1, interval * 2)
+      key, err, partial = system._readansi(0)
     end
-
-    -- error, or timeout reached, return the sequence so far
-    local partial = string.char(unpack(sequence))
-    return nil, err, partial
+    return key, err, partial
   end
 end
 